@@ -0,0 +1,44 @@
+/**This file is part of powercores, released under the terms of the Unlicense.
+See LICENSE in the root of the powercores repository for details.*/
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include "utilities.hpp"
+
+namespace powercores {
+
+/**A reusable barrier for a fixed number of threads.
+
+Each call to arriveAndWait blocks until count threads have called it, and then they all return.  The barrier is then immediately ready for the next round.
+It is sense-reversing: waiters watch a phase number which the last thread to arrive advances, so a fast thread may arrive for the next round before slow ones have left this one.
+
+Waiting threads spin for a while first, since barriers in audio code are usually short.  After that they sleep on a futex on Linux and on a condition variable elsewhere, and the last arriver only makes the wake-up call if someone is asleep.
+Nothing is allocated after construction.*/
+class Barrier {
+	public:
+	/**spinCount is how many times to check the phase before going to sleep.*/
+	Barrier(int count, int spinCount = 2000);
+	Barrier(const Barrier&) = delete;
+	Barrier& operator=(const Barrier&) = delete;
+
+	void arriveAndWait();
+
+	int getCount();
+
+	private:
+	void sleep(int phase);
+	void wakeAll();
+
+	int count, spin_count;
+	std::atomic<int> remaining;
+	char pad[CACHE_LINE_SIZE];
+	std::atomic<int> phase{0};
+	std::atomic<int> sleepers{0};
+#ifndef __linux__
+	std::mutex lock;
+	std::condition_variable phase_changed;
+#endif
+};
+
+}
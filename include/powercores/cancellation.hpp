@@ -0,0 +1,102 @@
+/**This file is part of powercores, released under the terms of the Unlicense.
+See LICENSE in the root of the powercores repository for details.*/
+#pragma once
+#include <atomic>
+#include <utility>
+#include "pool_allocator.hpp"
+
+namespace powercores {
+
+//Internal to CancellationSource and CancellationToken, do not use.
+class CancellationState: public PoolAllocated {
+	public:
+	void release() {
+		if(references.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this;
+	}
+	std::atomic<bool> cancelled{false};
+	std::atomic<int> references{1};
+};
+
+/**Says whether work has been cancelled, through the CancellationSource it came from.
+Attach one to jobs with the ThreadPool overloads which take a token: they are skipped if it's cancelled before they start, and while they run CancellationToken::current returns it, so long jobs can check it and stop early.
+Tokens are cheap to copy.  A default-constructed token is never cancelled.*/
+class CancellationToken {
+	public:
+	CancellationToken() {}
+	CancellationToken(const CancellationToken &other): state(other.state) {
+		if(state) state->references.fetch_add(1, std::memory_order_relaxed);
+	}
+	CancellationToken(CancellationToken &&other) noexcept: state(other.state) {
+		other.state = nullptr;
+	}
+	CancellationToken& operator=(CancellationToken other) noexcept {
+		std::swap(state, other.state);
+		return *this;
+	}
+	~CancellationToken() {
+		if(state) state->release();
+	}
+
+	bool isCancelled() const {
+		return state != nullptr && state->cancelled.load(std::memory_order_acquire);
+	}
+
+	/**The token of the job running on this thread, or one which is never cancelled if there isn't one.*/
+	static CancellationToken current();
+
+	private:
+	friend class CancellationSource;
+	friend class CancellationScope;
+	explicit CancellationToken(CancellationState* s): state(s) {
+		if(state) state->references.fetch_add(1, std::memory_order_relaxed);
+	}
+	CancellationState* state = nullptr;
+};
+
+/**Cancels the tokens made from it.  Copies share the same cancellation, and cancelling can't be undone.*/
+class CancellationSource {
+	public:
+	CancellationSource(): state(new CancellationState()) {}
+	CancellationSource(const CancellationSource &other): state(other.state) {
+		state->references.fetch_add(1, std::memory_order_relaxed);
+	}
+	CancellationSource& operator=(const CancellationSource &other) {
+		other.state->references.fetch_add(1, std::memory_order_relaxed);
+		state->release();
+		state = other.state;
+		return *this;
+	}
+	~CancellationSource() {
+		state->release();
+	}
+
+	void cancel() {
+		state->cancelled.store(true, std::memory_order_release);
+	}
+
+	bool isCancelled() const {
+		return state->cancelled.load(std::memory_order_acquire);
+	}
+
+	CancellationToken getToken() const {
+		return CancellationToken(state);
+	}
+
+	private:
+	CancellationState* state;
+};
+
+/**Internal to ThreadPool, do not use.
+Makes token the one CancellationToken::current returns, until the scope ends.*/
+class CancellationScope {
+	public:
+	CancellationScope(const CancellationToken &token);
+	~CancellationScope();
+	CancellationScope(const CancellationScope&) = delete;
+	CancellationScope& operator=(const CancellationScope&) = delete;
+
+	private:
+	CancellationState* previous;
+};
+
+}
@@ -0,0 +1,98 @@
+/**This file is part of powercores, released under the terms of the Unlicense.
+See LICENSE in the root of the powercores repository for details.*/
+#pragma once
+#include <mutex>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <utility>
+#include "thread_local_variable.hpp"
+#include "pool_allocator.hpp"
+#include "utilities.hpp"
+
+namespace powercores {
+
+//Internal to CombinableVariable, do not use.
+//Padded on both sides, so that no two threads' values share a cache line, whatever the allocator does.
+template<typename T>
+class CombinableSlot {
+	public:
+	CombinableSlot(T v): value(std::move(v)) {}
+	char pad0[CACHE_LINE_SIZE];
+	T value;
+	char pad1[CACHE_LINE_SIZE];
+};
+
+/**A thread-local variable whose values can all be reached from one place: accumulate per thread in a parallel phase, then combine.
+Use it for counters, meters and histograms instead of contended atomics.
+
+Dereferencing costs the same as for ThreadLocalVariable.  A thread's first access creates its value with the initializer, and adds it to a list under a lock.
+Each value is padded by a cache line on either side, so updates from different threads never share a line.
+Values belong to the CombinableVariable, not to their threads: a value outlives the thread which made it, and still counts in forEach and combine, until clear or the destructor.
+
+forEach, combine and clear read every thread's value, so call them after the parallel phase, once no thread is updating; the pool's futures and barriers are enough to make sure of that.*/
+template<typename T>
+class CombinableVariable {
+	public:
+	CombinableVariable(): CombinableVariable([] () {return T();}) {}
+	/**initializer gives every thread's starting value, and the result of combine when no thread has a value.*/
+	CombinableVariable(std::function<T()> initializer): initializer(initializer) {
+		makeLocal();
+	}
+	~CombinableVariable() {
+		for(auto i: slots) poolDelete(i);
+	}
+	CombinableVariable(const CombinableVariable&) = delete;
+	CombinableVariable& operator=(const CombinableVariable&) = delete;
+
+	T& operator*() {
+		return **local;
+	}
+
+	T* operator->() {
+		return &**local;
+	}
+
+	/**Call callable(T&) on every thread's value.*/
+	template<typename CallableT>
+	void forEach(CallableT &&callable) {
+		std::lock_guard<std::mutex> l(lock);
+		for(auto i: slots) callable(i->value);
+	}
+
+	/**Fold every thread's value together with combine(T, T), which should be associative and commutative.*/
+	template<typename CombineT>
+	T combine(CombineT &&combine) {
+		std::lock_guard<std::mutex> l(lock);
+		if(slots.empty()) return initializer();
+		T ret = slots[0]->value;
+		for(unsigned int i = 1; i < slots.size(); i++) ret = combine(ret, slots[i]->value);
+		return ret;
+	}
+
+	/**Forget every thread's value.  Threads get fresh ones from the initializer on their next access.*/
+	void clear() {
+		std::lock_guard<std::mutex> l(lock);
+		//A new variable, so that no thread can still reach the old values.
+		makeLocal();
+		for(auto i: slots) poolDelete(i);
+		slots.clear();
+	}
+
+	private:
+	void makeLocal() {
+		local.reset(new ThreadLocalVariable<T>([this] () {
+			auto slot = poolNew<CombinableSlot<T>>(initializer());
+			std::lock_guard<std::mutex> l(lock);
+			slots.push_back(slot);
+			return &slot->value;
+		}, [] (T*) {}));
+	}
+
+	std::function<T()> initializer;
+	std::unique_ptr<ThreadLocalVariable<T>> local;
+	std::mutex lock;
+	std::vector<CombinableSlot<T>*> slots;
+};
+
+}
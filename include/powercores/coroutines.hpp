@@ -0,0 +1,257 @@
+/**This file is part of powercores, released under the terms of the Unlicense.
+See LICENSE in the root of the powercores repository for details.*/
+#pragma once
+
+/*Coroutine support for ThreadPool.
+This needs C++20.  The rest of powercores builds as C++14, so everything here lives in this header and disappears when the compiler doesn't support coroutines; check POWERCORES_HAS_COROUTINES.*/
+#if defined(__has_include)
+#if __has_include(<coroutine>) && defined(__cpp_impl_coroutine)
+#define POWERCORES_HAS_COROUTINES 1
+#endif
+#endif
+
+#ifdef POWERCORES_HAS_COROUTINES
+#include <coroutine>
+#include <exception>
+#include <future>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include "thread_pool.hpp"
+
+namespace powercores {
+
+/**Awaiting this moves the coroutine onto one of the pool's workers, by submitting a job which resumes it.*/
+class ScheduleOnAwaitable {
+	public:
+	ScheduleOnAwaitable(ThreadPool &pool, JobPriority priority): pool(pool), priority(priority) {}
+	bool await_ready() const noexcept {return false;}
+	void await_suspend(std::coroutine_handle<> handle) {
+		pool.submitJob(priority, [handle] () {handle.resume();});
+	}
+	void await_resume() const noexcept {}
+
+	private:
+	ThreadPool &pool;
+	JobPriority priority;
+};
+
+/**co_await scheduleOn(pool) to continue on a worker of pool.*/
+inline ScheduleOnAwaitable scheduleOn(ThreadPool &pool, JobPriority priority = JobPriority::NORMAL) {
+	return ScheduleOnAwaitable(pool, priority);
+}
+
+template<typename T>
+class CoroutineTask;
+
+//Internal helpers for CoroutineTask, do not use.
+class CoroutinePromiseBase {
+	public:
+	//When the task finishes, go straight on to whoever awaited it, on the same thread.
+	class FinalAwaiter {
+		public:
+		bool await_ready() const noexcept {return false;}
+		template<typename PromiseT>
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<PromiseT> handle) noexcept {
+			auto continuation = handle.promise().continuation;
+			if(continuation) return continuation;
+			return std::noop_coroutine();
+		}
+		void await_resume() const noexcept {}
+	};
+
+	//Frames are usually created on one thread and destroyed on a worker, which is what the pool allocator is for.
+	static void* operator new(std::size_t size) {
+		return poolAllocate(size);
+	}
+	static void operator delete(void* p) {
+		poolFree(p);
+	}
+
+	std::suspend_always initial_suspend() noexcept {return {};}
+	FinalAwaiter final_suspend() noexcept {return {};}
+	void unhandled_exception() {
+		exception = std::current_exception();
+	}
+
+	std::coroutine_handle<> continuation;
+	std::exception_ptr exception;
+};
+
+template<typename T>
+class CoroutinePromise: public CoroutinePromiseBase {
+	public:
+	CoroutineTask<T> get_return_object();
+	template<typename U>
+	void return_value(U &&v) {
+		value.emplace(std::forward<U>(v));
+	}
+	T result() {
+		if(exception) std::rethrow_exception(exception);
+		return std::move(*value);
+	}
+	std::optional<T> value;
+};
+
+template<>
+class CoroutinePromise<void>: public CoroutinePromiseBase {
+	public:
+	CoroutineTask<void> get_return_object();
+	void return_void() {}
+	void result() {
+		if(exception) std::rethrow_exception(exception);
+	}
+};
+
+/**A coroutine which produces a T.
+
+It is lazy: nothing runs until it is awaited, and then it runs on the awaiting thread until it suspends.
+Use co_await scheduleOn(pool) inside it to move to a worker.  A suspended coroutine is just its frame on the heap, so it doesn't tie up a thread.
+Exceptions propagate to whoever awaits it.
+From code which isn't a coroutine, start one with spawn.*/
+template<typename T>
+class CoroutineTask {
+	public:
+	typedef CoroutinePromise<T> promise_type;
+
+	CoroutineTask(CoroutineTask &&other) noexcept: handle(other.handle) {
+		other.handle = nullptr;
+	}
+	CoroutineTask& operator=(CoroutineTask &&other) noexcept {
+		if(this != &other) {
+			if(handle) handle.destroy();
+			handle = other.handle;
+			other.handle = nullptr;
+		}
+		return *this;
+	}
+	CoroutineTask(const CoroutineTask&) = delete;
+	CoroutineTask& operator=(const CoroutineTask&) = delete;
+	~CoroutineTask() {
+		if(handle) handle.destroy();
+	}
+
+	bool await_ready() const noexcept {return false;}
+	std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+		handle.promise().continuation = awaiting;
+		return handle;
+	}
+	T await_resume() {
+		return handle.promise().result();
+	}
+
+	private:
+	friend class CoroutinePromise<T>;
+	explicit CoroutineTask(std::coroutine_handle<promise_type> h): handle(h) {}
+	std::coroutine_handle<promise_type> handle;
+};
+
+template<typename T>
+CoroutineTask<T> CoroutinePromise<T>::get_return_object() {
+	return CoroutineTask<T>(std::coroutine_handle<CoroutinePromise<T>>::from_promise(*this));
+}
+
+inline CoroutineTask<void> CoroutinePromise<void>::get_return_object() {
+	return CoroutineTask<void>(std::coroutine_handle<CoroutinePromise<void>>::from_promise(*this));
+}
+
+/**Awaiting this runs a callable as a job on the pool and resumes with its result, or rethrows what it threw.
+The coroutine continues on the worker which ran the job.*/
+template<typename CallableT>
+class JobAwaitable {
+	public:
+	typedef std::invoke_result_t<CallableT&> ResultT;
+
+	JobAwaitable(ThreadPool &pool, CallableT callable, JobPriority priority): pool(pool), callable(std::move(callable)), priority(priority) {}
+	bool await_ready() const noexcept {return false;}
+	void await_suspend(std::coroutine_handle<> handle) {
+		//We live in the suspended coroutine's frame, so we stay put until it resumes.
+		pool.submitJob(priority, [this, handle] () {
+			try {
+				if constexpr(std::is_void_v<ResultT>) callable();
+				else result.emplace(callable());
+			}
+			catch(...) {
+				exception = std::current_exception();
+			}
+			handle.resume();
+		});
+	}
+	ResultT await_resume() {
+		if(exception) std::rethrow_exception(exception);
+		if constexpr(std::is_void_v<ResultT> == false) return std::move(*result);
+	}
+
+	private:
+	ThreadPool &pool;
+	CallableT callable;
+	JobPriority priority;
+	std::conditional_t<std::is_void_v<ResultT>, char, std::optional<ResultT>> result;
+	std::exception_ptr exception;
+};
+
+/**co_await awaitJob(pool, callable) to run callable on the pool without blocking a thread on a future.*/
+template<typename CallableT>
+JobAwaitable<std::decay_t<CallableT>> awaitJob(ThreadPool &pool, CallableT &&callable, JobPriority priority = JobPriority::NORMAL) {
+	return JobAwaitable<std::decay_t<CallableT>>(pool, std::forward<CallableT>(callable), priority);
+}
+
+/**Awaiting this submits a barrier, and resumes once every job submitted before it has finished.*/
+class BarrierAwaitable {
+	public:
+	BarrierAwaitable(ThreadPool &pool): pool(pool) {}
+	bool await_ready() const noexcept {return false;}
+	void await_suspend(std::coroutine_handle<> handle) {
+		pool.submitBarrier();
+		pool.submitJob([handle] () {handle.resume();});
+	}
+	void await_resume() const noexcept {}
+
+	private:
+	ThreadPool &pool;
+};
+
+/**co_await awaitBarrier(pool) instead of submitBarrier followed by waiting on a job.*/
+inline BarrierAwaitable awaitBarrier(ThreadPool &pool) {
+	return BarrierAwaitable(pool);
+}
+
+//Internal helper for spawn, do not use.  A coroutine which starts at once and cleans up after itself.
+class DetachedCoroutine {
+	public:
+	class promise_type {
+		public:
+		DetachedCoroutine get_return_object() noexcept {return {};}
+		std::suspend_never initial_suspend() noexcept {return {};}
+		std::suspend_never final_suspend() noexcept {return {};}
+		void return_void() noexcept {}
+		void unhandled_exception() noexcept {std::terminate();}
+	};
+};
+
+template<typename T>
+DetachedCoroutine runDetached(ThreadPool &pool, CoroutineTask<T> task, std::promise<T> promise) {
+	co_await scheduleOn(pool);
+	try {
+		if constexpr(std::is_void_v<T>) {
+			co_await task;
+			promise.set_value();
+		}
+		else promise.set_value(co_await task);
+	}
+	catch(...) {
+		promise.set_exception(std::current_exception());
+	}
+}
+
+/**Start a coroutine on the pool from code which isn't a coroutine.  The future becomes ready when it finishes.*/
+template<typename T>
+std::future<T> spawn(ThreadPool &pool, CoroutineTask<T> task) {
+	std::promise<T> promise;
+	auto ret = promise.get_future();
+	runDetached(pool, std::move(task), std::move(promise));
+	return ret;
+}
+
+}
+#endif
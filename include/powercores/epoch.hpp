@@ -0,0 +1,50 @@
+/**This file is part of powercores, released under the terms of the Unlicense.
+See LICENSE in the root of the powercores repository for details.*/
+#pragma once
+
+namespace powercores {
+
+/*Epoch-based reclamation, for freeing nodes of lock-free structures which other threads may still be reading.
+
+Readers bracket their accesses with an EpochGuard.  Writers unlink a node so that no new reader can find it, then hand it to epochRetire instead of deleting it.
+There is a global epoch, which only advances once every thread inside a guard has seen the current value; a node retired in epoch e is freed once the epoch reaches e+2, by which time every reader who could have found it has left its guard.
+
+Retired nodes wait on a list belonging to the thread which retired them, and are freed by that thread when it retires more, when it calls epochCollect, and, on pool workers, between jobs.  Readers never free anything.
+When a thread exits, its list is handed to whichever thread next collects, so nothing is lost.*/
+
+/**Enter a critical section: nothing retired from now on is freed until the matching epochLeave.
+Sections nest, and cost a fence on the way in.  Prefer EpochGuard.*/
+void epochEnter();
+void epochLeave();
+
+/**Free p with deleter once no thread in a critical section could still be reading it.
+Call this after unlinking p, from any thread, inside a critical section or not.  The deleter runs later, on whatever thread collects, so it must not take locks a reader might hold.*/
+void epochRetire(void* p, void (*deleter)(void*));
+
+/**epochRetire for objects from new.*/
+template<typename T>
+void epochDelete(T* p) {
+	if(p) epochRetire(p, [] (void* q) {delete static_cast<T*>(q);});
+}
+
+/**Try to advance the epoch and free what the calling thread has retired, including lists left by exited threads.
+With no thread in a critical section, this frees everything.  Call it now and then from threads which retire but aren't pool workers, or their last few nodes stay around until they exit.*/
+void epochCollect();
+
+//Internal to ThreadPool, do not use.  Called between jobs.
+void epochQuiescentPoint();
+
+/**Enters a critical section for its lifetime.*/
+class EpochGuard {
+	public:
+	EpochGuard() {
+		epochEnter();
+	}
+	~EpochGuard() {
+		epochLeave();
+	}
+	EpochGuard(const EpochGuard&) = delete;
+	EpochGuard& operator=(const EpochGuard&) = delete;
+};
+
+}
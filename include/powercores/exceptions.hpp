@@ -9,4 +9,12 @@ namespace powercores {
 class TimeoutException: public std::exception {
 };
 
+/**Thrown by TaskGraph::compile if the graph's edges form a cycle.*/
+class CycleException: public std::exception {
+};
+
+/**Stored in the future of a job whose CancellationToken was cancelled before it could finish.*/
+class JobCancelledException: public std::exception {
+};
+
 }
\ No newline at end of file
@@ -0,0 +1,504 @@
+/**This file is part of powercores, released under the terms of the Unlicense.
+See LICENSE in the root of the powercores repository for details.*/
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <exception>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include <memory>
+#include <iterator>
+#include <new>
+#include <cstddef>
+#include <type_traits>
+#include "task.hpp"
+#include "pool_allocator.hpp"
+
+namespace powercores {
+
+template<typename T>
+class Future;
+template<typename T>
+class Promise;
+
+//Internal helpers for Future and Promise, do not use.
+//Shared by one Future and one Promise.
+//status goes from EMPTY to READY, possibly by way of WAITING if a continuation arrives first; whichever side moves it second runs the continuation.
+class FutureStateBase: public PoolAllocated {
+	public:
+	enum {EMPTY, WAITING, READY};
+
+	virtual ~FutureStateBase() {}
+
+	//Called by the producer after storing a value or exception.
+	void complete() {
+		if(status.exchange(READY, std::memory_order_acq_rel) == WAITING) {
+			Task c = std::move(continuation);
+			c();
+		}
+	}
+
+	//Run c when the state becomes ready, on the thread which makes it ready, or now if it already is.
+	void setContinuation(Task c) {
+		continuation = std::move(c);
+		int expected = EMPTY;
+		if(status.compare_exchange_strong(expected, WAITING, std::memory_order_acq_rel) == false) {
+			Task now = std::move(continuation);
+			now();
+		}
+	}
+
+	bool isReady() {
+		return status.load(std::memory_order_acquire) == READY;
+	}
+
+	//Block until ready.  The continuation slot is free, since a Future can't both wait and have a continuation.
+	void wait() {
+		if(isReady()) return;
+		std::mutex m;
+		std::condition_variable cv;
+		bool done = false;
+		setContinuation([&] () {
+			std::lock_guard<std::mutex> l(m);
+			done = true;
+			cv.notify_one();
+		});
+		std::unique_lock<std::mutex> l(m);
+		cv.wait(l, [&] () {return done;});
+	}
+
+	void release() {
+		if(references.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this;
+	}
+
+	std::atomic<int> status{EMPTY};
+	std::atomic<int> references{1};
+	Task continuation;
+	std::exception_ptr exception;
+};
+
+template<typename T>
+class FutureState: public FutureStateBase {
+	public:
+	~FutureState() {
+		if(has_value) reinterpret_cast<T*>(&storage)->~T();
+	}
+
+	template<typename U>
+	void setValue(U &&v) {
+		new(&storage) T(std::forward<U>(v));
+		has_value = true;
+	}
+
+	T takeValue() {
+		return std::move(*reinterpret_cast<T*>(&storage));
+	}
+
+	//Call callable with the value.
+	template<typename CallableT>
+	auto apply(CallableT &callable) -> decltype(callable(std::declval<T>())) {
+		return callable(takeValue());
+	}
+
+	private:
+	typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+	bool has_value = false;
+};
+
+template<>
+class FutureState<void>: public FutureStateBase {
+	public:
+	void takeValue() {}
+
+	template<typename CallableT>
+	auto apply(CallableT &callable) -> decltype(callable()) {
+		return callable();
+	}
+};
+
+//The type a continuation of a Future<T> returns.
+template<typename T, typename CallableT>
+struct FutureContinuationResult {
+	typedef typename std::result_of<CallableT(T)>::type type;
+};
+
+template<typename CallableT>
+struct FutureContinuationResult<void, CallableT> {
+	typedef typename std::result_of<CallableT()>::type type;
+};
+
+//Call callable and put what it returns, or what it throws, in promise.
+template<typename T>
+struct FutureFulfil {
+	template<typename CallableT>
+	static void run(Promise<T> &promise, CallableT &&callable) {
+		try {
+			promise.setValue(callable());
+		}
+		catch(...) {
+			promise.setException(std::current_exception());
+		}
+	}
+};
+
+template<>
+struct FutureFulfil<void> {
+	template<typename CallableT>
+	static void run(Promise<void> &promise, CallableT &&callable);
+};
+
+/**The result of a computation which may not have finished yet.
+
+Unlike std::future, a Future can be given a continuation with then, which runs when the value arrives instead of blocking a thread to wait for it.
+whenAll and whenAny combine Futures, so fan-out and fan-in are possible without parking anything.
+The shared state comes from the pool allocator and continuations are stored inline as Tasks, so a Future and its continuation usually allocate nothing.
+
+Futures are move-only.  get, then and onReady consume the Future, after which valid returns false.*/
+template<typename T>
+class Future {
+	public:
+	typedef T value_type;
+
+	Future() {}
+	Future(Future &&other) noexcept: state(other.state) {
+		other.state = nullptr;
+	}
+	Future& operator=(Future &&other) noexcept {
+		if(this != &other) {
+			if(state) state->release();
+			state = other.state;
+			other.state = nullptr;
+		}
+		return *this;
+	}
+	Future(const Future&) = delete;
+	Future& operator=(const Future&) = delete;
+	~Future() {
+		if(state) state->release();
+	}
+
+	bool valid() const {
+		return state != nullptr;
+	}
+
+	/**True once the value or an exception has arrived.  Never blocks.*/
+	bool isReady() const {
+		return state->isReady();
+	}
+
+	/**Block until ready.*/
+	void wait() {
+		state->wait();
+	}
+
+	/**Block until ready, then return the value or throw the exception.*/
+	T get() {
+		auto s = take();
+		s->wait();
+		Releaser r{s};
+		if(s->exception) std::rethrow_exception(s->exception);
+		return s->takeValue();
+	}
+
+	/**Call callable(value), or callable() for a Future<void>, once the value arrives, and return a Future for what it returns.
+	The continuation runs inline, on whichever thread completes this Future, or on the calling thread if it already has; keep it short.
+	If this Future holds an exception, callable isn't called and the exception passes to the returned Future, as does any exception callable throws.*/
+	template<typename CallableT>
+	Future<typename FutureContinuationResult<T, typename std::decay<CallableT>::type>::type> then(CallableT &&callable) {
+		typedef typename FutureContinuationResult<T, typename std::decay<CallableT>::type>::type U;
+		Promise<U> promise;
+		auto ret = promise.getFuture();
+		auto s = take();
+		s->setContinuation([s, promise = std::move(promise), callable = typename std::decay<CallableT>::type(std::forward<CallableT>(callable))] () mutable {
+			runContinuation(s, promise, callable);
+		});
+		return ret;
+	}
+
+	/**Like then, but the continuation is submitted as a job to executor, which is anything with a submitJob taking a callable, such as a ThreadPool.*/
+	template<typename ExecutorT, typename CallableT>
+	Future<typename FutureContinuationResult<T, typename std::decay<CallableT>::type>::type> then(ExecutorT &executor, CallableT &&callable) {
+		typedef typename FutureContinuationResult<T, typename std::decay<CallableT>::type>::type U;
+		Promise<U> promise;
+		auto ret = promise.getFuture();
+		auto s = take();
+		ExecutorT* e = &executor;
+		s->setContinuation([s, e, promise = std::move(promise), callable = typename std::decay<CallableT>::type(std::forward<CallableT>(callable))] () mutable {
+			e->submitJob([s, promise = std::move(promise), callable = std::move(callable)] () mutable {
+				runContinuation(s, promise, callable);
+			});
+		});
+		return ret;
+	}
+
+	/**Call callable(future) inline once this is ready, passing a ready Future holding the value or exception.
+	This is the building block of whenAll and whenAny.*/
+	template<typename CallableT>
+	void onReady(CallableT &&callable) {
+		auto s = take();
+		s->setContinuation([s, callable = typename std::decay<CallableT>::type(std::forward<CallableT>(callable))] () mutable {
+			callable(Future<T>(s));
+		});
+	}
+
+	private:
+	friend class Promise<T>;
+	explicit Future(FutureState<T>* s): state(s) {}
+
+	struct Releaser {
+		~Releaser() {
+			s->release();
+		}
+		FutureState<T>* s;
+	};
+
+	FutureState<T>* take() {
+		if(state == nullptr) throw std::future_error(std::future_errc::no_state);
+		auto s = state;
+		state = nullptr;
+		return s;
+	}
+
+	template<typename U, typename CallableT>
+	static void runContinuation(FutureState<T>* s, Promise<U> &promise, CallableT &callable) {
+		Releaser r{s};
+		if(s->exception) promise.setException(s->exception);
+		else FutureFulfil<U>::run(promise, [&] () {return s->apply(callable);});
+	}
+
+	FutureState<T>* state = nullptr;
+};
+
+/**The producing side of a Future.
+If a Promise is destroyed without a value or exception, its Future receives std::future_error with broken_promise.*/
+template<typename T>
+class Promise {
+	public:
+	Promise(): state(new FutureState<T>()) {}
+	Promise(Promise &&other) noexcept: state(other.state), retrieved(other.retrieved) {
+		other.state = nullptr;
+	}
+	Promise& operator=(Promise &&other) noexcept {
+		if(this != &other) {
+			abandon();
+			state = other.state;
+			retrieved = other.retrieved;
+			other.state = nullptr;
+		}
+		return *this;
+	}
+	Promise(const Promise&) = delete;
+	Promise& operator=(const Promise&) = delete;
+	~Promise() {
+		abandon();
+	}
+
+	/**Get the Future.  This may only be called once.*/
+	Future<T> getFuture() {
+		if(retrieved) throw std::future_error(std::future_errc::future_already_retrieved);
+		retrieved = true;
+		state->references.fetch_add(1, std::memory_order_relaxed);
+		return Future<T>(state);
+	}
+
+	template<typename U>
+	void setValue(U &&v) {
+		auto s = take();
+		s->setValue(std::forward<U>(v));
+		finish(s);
+	}
+
+	/**Only for Promise<void>.*/
+	template<typename U = T, typename = typename std::enable_if<std::is_void<U>::value>::type>
+	void setValue() {
+		finish(take());
+	}
+
+	void setException(std::exception_ptr e) {
+		auto s = take();
+		s->exception = e;
+		finish(s);
+	}
+
+	private:
+	FutureState<T>* take() {
+		if(state == nullptr) throw std::future_error(std::future_errc::promise_already_satisfied);
+		auto s = state;
+		state = nullptr;
+		return s;
+	}
+
+	void finish(FutureState<T>* s) {
+		s->complete();
+		s->release();
+	}
+
+	void abandon() {
+		if(state == nullptr) return;
+		setException(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+	}
+
+	FutureState<T>* state;
+	bool retrieved = false;
+};
+
+template<typename CallableT>
+void FutureFulfil<void>::run(Promise<void> &promise, CallableT &&callable) {
+	try {
+		callable();
+		promise.setValue();
+	}
+	catch(...) {
+		promise.setException(std::current_exception());
+	}
+}
+
+//Internal helpers for whenAll and whenAny, do not use.
+class WhenAllStateBase: public PoolAllocated {
+	public:
+	WhenAllStateBase(int count): remaining(count) {}
+	void fail(std::exception_ptr e) {
+		if(failed.exchange(true) == false) error = e;
+	}
+	std::atomic<int> remaining;
+	std::atomic<bool> failed{false};
+	std::exception_ptr error;
+};
+
+template<typename T>
+class WhenAllState: public WhenAllStateBase {
+	public:
+	WhenAllState(int count): WhenAllStateBase(count), count(count), results(new T[count]) {}
+	void arrive(int i, Future<T> &f) {
+		try {
+			results[i] = f.get();
+		}
+		catch(...) {
+			fail(std::current_exception());
+		}
+		if(remaining.fetch_sub(1) == 1) complete();
+	}
+	void complete() {
+		if(failed.load()) promise.setException(error);
+		else promise.setValue(std::vector<T>(std::make_move_iterator(results.get()), std::make_move_iterator(results.get()+count)));
+		delete this;
+	}
+	int count;
+	//Not a vector, since futures arrive on different threads and std::vector<bool> packs neighbours into one word.
+	std::unique_ptr<T[]> results;
+	Promise<std::vector<T>> promise;
+};
+
+template<>
+class WhenAllState<void>: public WhenAllStateBase {
+	public:
+	WhenAllState(int count): WhenAllStateBase(count) {}
+	void arrive(int, Future<void> &f) {
+		try {
+			f.get();
+		}
+		catch(...) {
+			fail(std::current_exception());
+		}
+		if(remaining.fetch_sub(1) == 1) complete();
+	}
+	void complete() {
+		if(failed.load()) promise.setException(error);
+		else promise.setValue();
+		delete this;
+	}
+	Promise<void> promise;
+};
+
+/**A Future which becomes ready when all of futures are.
+It holds every value in order, or the first exception if any of them failed.  T must be default constructible.
+The futures are consumed, and nothing blocks: the last one to arrive completes the result.*/
+template<typename T>
+Future<std::vector<T>> whenAll(std::vector<Future<T>> &futures) {
+	auto state = new WhenAllState<T>(futures.size());
+	auto ret = state->promise.getFuture();
+	if(futures.empty()) {
+		state->complete();
+		return ret;
+	}
+	for(int i = 0; i < (int)futures.size(); i++) futures[i].onReady([state, i] (Future<T> f) {state->arrive(i, f);});
+	return ret;
+}
+
+/**whenAll for Futures without values.*/
+inline Future<void> whenAll(std::vector<Future<void>> &futures) {
+	auto state = new WhenAllState<void>(futures.size());
+	auto ret = state->promise.getFuture();
+	if(futures.empty()) {
+		state->complete();
+		return ret;
+	}
+	for(int i = 0; i < (int)futures.size(); i++) futures[i].onReady([state, i] (Future<void> f) {state->arrive(i, f);});
+	return ret;
+}
+
+template<typename T>
+class WhenAnyState: public PoolAllocated {
+	public:
+	WhenAnyState(int count): remaining(count) {}
+	void arrive(std::size_t i, Future<T> &f) {
+		if(done.exchange(true) == false) {
+			try {
+				promise.setValue(std::make_pair(i, f.get()));
+			}
+			catch(...) {
+				promise.setException(std::current_exception());
+			}
+		}
+		if(remaining.fetch_sub(1) == 1) delete this;
+	}
+	std::atomic<int> remaining;
+	std::atomic<bool> done{false};
+	Promise<std::pair<std::size_t, T>> promise;
+};
+
+template<>
+class WhenAnyState<void>: public PoolAllocated {
+	public:
+	WhenAnyState(int count): remaining(count) {}
+	void arrive(std::size_t i, Future<void> &f) {
+		if(done.exchange(true) == false) {
+			try {
+				f.get();
+				promise.setValue(i);
+			}
+			catch(...) {
+				promise.setException(std::current_exception());
+			}
+		}
+		if(remaining.fetch_sub(1) == 1) delete this;
+	}
+	std::atomic<int> remaining;
+	std::atomic<bool> done{false};
+	Promise<std::size_t> promise;
+};
+
+/**A Future which becomes ready when the first of futures does, holding its index and value, or its exception.
+The futures are consumed.  futures must not be empty.*/
+template<typename T>
+Future<std::pair<std::size_t, T>> whenAny(std::vector<Future<T>> &futures) {
+	if(futures.empty()) throw std::invalid_argument("whenAny needs at least one future");
+	auto state = new WhenAnyState<T>(futures.size());
+	auto ret = state->promise.getFuture();
+	for(std::size_t i = 0; i < futures.size(); i++) futures[i].onReady([state, i] (Future<T> f) {state->arrive(i, f);});
+	return ret;
+}
+
+/**whenAny for Futures without values.  The result is the index of the first to become ready.*/
+inline Future<std::size_t> whenAny(std::vector<Future<void>> &futures) {
+	if(futures.empty()) throw std::invalid_argument("whenAny needs at least one future");
+	auto state = new WhenAnyState<void>(futures.size());
+	auto ret = state->promise.getFuture();
+	for(std::size_t i = 0; i < futures.size(); i++) futures[i].onReady([state, i] (Future<void> f) {state->arrive(i, f);});
+	return ret;
+}
+
+}
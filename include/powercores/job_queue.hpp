@@ -0,0 +1,429 @@
+/**This file is part of powercores, released under the terms of the Unlicense.
+See LICENSE in the root of the powercores repository for details.*/
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+#include <utility>
+#include <memory>
+#include "lock_free_queue.hpp"
+#include "task.hpp"
+#include "wait_policy.hpp"
+
+namespace powercores {
+
+/**Workers always take HIGH jobs before NORMAL ones, and NORMAL before LOW, except as described under ThreadPool::setStarvationLimit.*/
+enum class JobPriority {
+	HIGH,
+	NORMAL,
+	LOW,
+};
+
+const int JOB_PRIORITIES = 3;
+
+/**The per-worker queue used by ThreadPool.
+
+This is a queue which knows about three things the pool needs: priorities, pinned jobs and stealing.
+Each priority has its own lane.  Barriers and other pinned jobs are always in the NORMAL lane, and order only that lane.
+A pinned job must run on the worker which owns the queue; barriers, poison, and jobs submitted to all threads are pinned.
+Other workers may steal jobs, but never a pinned job and never anything which the owner must run after one.
+This is what keeps barriers meaningful when work stealing is turned on.
+Threads outside the pool may take jobs too, but only while no pinned job is pending, and the owner waits for those jobs to finish before running its next pinned job.
+
+Within a lane, jobs start in the order they were enqueued, whether the owner or a thief takes them.
+
+There are two implementations, chosen with ThreadPool::setJobQueueBackend.*/
+class JobQueue {
+	public:
+	typedef Task JobT;
+
+	/**A queued job, with what the pool needs to know about it.*/
+	struct Entry {
+		Entry() = default;
+		Entry(JobT j, bool p = false, long long s = 0, JobPriority pr = JobPriority::NORMAL): job(std::move(j)), pinned(p), submitted(s), priority(pr) {}
+		JobT job;
+		/**Pinned jobs are never stolen.*/
+		bool pinned = false;
+		/**When the job was submitted, in nanoseconds, or 0 if the pool isn't keeping statistics.*/
+		long long submitted = 0;
+		/**Ignored for pinned jobs, which are always NORMAL.*/
+		JobPriority priority = JobPriority::NORMAL;
+	};
+
+	/**After a lane with work has been passed over starvationLimit times, the owner takes its next jobs from that lane.*/
+	JobQueue(int starvationLimit): starvation_limit(starvationLimit) {}
+	virtual ~JobQueue() {}
+
+	/**Enqueue a job, returning how many jobs are in the queue afterwards.*/
+	virtual unsigned int enqueue(Entry entry) = 0;
+
+	/**Enqueue a range of unpinned jobs, returning how many jobs are in the queue afterwards.*/
+	template<class IterT>
+	unsigned int enqueueRange(IterT begin, IterT end, long long submitted = 0) {
+		Entry batch[16];
+		int count = 0;
+		unsigned int ret = 0;
+		for(; begin != end; begin++) {
+			batch[count++] = Entry(JobT(*begin), false, submitted);
+			if(count == 16) {
+				ret = enqueueBatch(batch, count);
+				count = 0;
+			}
+		}
+		if(count) ret = enqueueBatch(batch, count);
+		return ret;
+	}
+
+	/**Owner side: dequeue at least one and at most count jobs, waiting until there is one according to the queue's WaitPolicy.
+	For every pinned job returned, the owner must call finishPinned once the job has run.*/
+	virtual int dequeueRange(int count, Entry* output) = 0;
+
+	/**Like dequeueRange, but returns 0 instead of sleeping if the queue is empty.*/
+	virtual int tryDequeueRange(int count, Entry* output) = 0;
+
+	/**Called by the owner once a pinned job has finished running.*/
+	virtual void finishPinned() = 0;
+
+	/**Thief side: take the oldest job of the highest priority lane, if it may be stolen.*/
+	virtual bool trySteal(Entry &output) = 0;
+
+	/**True if a pinned job is the next job in the NORMAL lane.*/
+	virtual bool pinnedNext() = 0;
+
+	/**True if trySteal would currently succeed.*/
+	virtual bool canSteal() = 0;
+
+	/**Thief side, for threads which aren't workers of the pool, such as callers of ThreadPool::waitFor.
+	A worker which steals can't reach its own barrier until the stolen job is done, but an outside thread never arrives at barriers, so trySteal's rules aren't enough.
+	This only takes a job while no pinned job is queued or running.  Call finishExternal once the job has run.*/
+	virtual bool tryStealExternal(Entry &output) = 0;
+
+	/**True if tryStealExternal would currently succeed.*/
+	virtual bool canStealExternal() = 0;
+
+	void finishExternal() {
+		external_jobs.fetch_sub(1, std::memory_order_release);
+	}
+
+	/**Owner side: wait until every job taken with tryStealExternal has finished.
+	Called before running a pinned job, so that a barrier can't pass while an outside thread is still running a job which was queued ahead of it.*/
+	void waitForExternal() {
+		while(external_jobs.load(std::memory_order_acquire)) std::this_thread::yield();
+	}
+
+	/**empty and size never take a lock, so that idle workers can spin on them.*/
+	virtual bool empty() = 0;
+
+	/**Get the current number of jobs in the queue.*/
+	virtual unsigned int size() = 0;
+
+	protected:
+	virtual unsigned int enqueueBatch(Entry* entries, int count) = 0;
+
+	//Jobs taken by tryStealExternal which haven't finished.
+	std::atomic<int> external_jobs{0};
+
+	static int laneOf(const Entry &entry) {
+		return entry.pinned ? (int)JobPriority::NORMAL : (int)entry.priority;
+	}
+
+	/**Owner side: which lane to serve next, given which have work, or -1 if none do.
+	The highest priority lane with work, unless a lower one has been starved.*/
+	int pickLane(const bool* hasWork) {
+		int ret = -1;
+		for(int i = JOB_PRIORITIES-1; i >= 0 && ret == -1; i--) {
+			if(hasWork[i] && passed_over[i] >= starvation_limit) ret = i;
+		}
+		for(int i = 0; i < JOB_PRIORITIES && ret == -1; i++) {
+			if(hasWork[i]) ret = i;
+		}
+		for(int i = 0; i < JOB_PRIORITIES; i++) {
+			if(i == ret) passed_over[i] = 0;
+			else if(hasWork[i]) passed_over[i]++;
+		}
+		return ret;
+	}
+
+	private:
+	int starvation_limit;
+	//Only touched by the owner.
+	int passed_over[JOB_PRIORITIES] = {0};
+};
+
+/**A JobQueue protected by a mutex.
+
+Thieves can look at the oldest job before taking it, so they take anything ahead of a pinned job and stop at it.
+While the owner runs a pinned job the queue is fenced, and nothing is stolen.*/
+class LockingJobQueue: public JobQueue {
+	public:
+	LockingJobQueue(WaitPolicy waitPolicy = WaitPolicy(), int starvationLimit = 16): JobQueue(starvationLimit), wait_policy(waitPolicy) {}
+
+	unsigned int enqueue(Entry entry) override {
+		std::unique_lock<std::mutex> l(lock);
+		if(entry.pinned) pinned_count++;
+		lanes[laneOf(entry)].emplace_back(std::move(entry));
+		updateCount();
+		if(owner_sleeping) enqueued_notify.notify_one();
+		return job_count.load(std::memory_order_relaxed);
+	}
+
+	int dequeueRange(int count, Entry* output) override {
+		wait_policy.wait([this] () {return empty() == false;});
+		std::unique_lock<std::mutex> l(lock);
+		if(empty()) {
+			owner_sleeping = true;
+			enqueued_notify.wait(l, [this] () {return empty() == false;});
+			owner_sleeping = false;
+		}
+		return actualDequeueRange(count, output);
+	}
+
+	int tryDequeueRange(int count, Entry* output) override {
+		std::unique_lock<std::mutex> l(lock);
+		return actualDequeueRange(count, output);
+	}
+
+	void finishPinned() override {
+		std::lock_guard<std::mutex> l(lock);
+		fenced = false;
+		pinned_count--;
+	}
+
+	bool trySteal(Entry &output) override {
+		std::lock_guard<std::mutex> l(lock);
+		int lane = stealableLane();
+		if(lane == -1) return false;
+		output = std::move(lanes[lane].front());
+		lanes[lane].pop_front();
+		updateCount();
+		return true;
+	}
+
+	/**Only the owner dequeues pinned jobs, so for the owner this stays true until it takes the job.*/
+	bool pinnedNext() override {
+		std::lock_guard<std::mutex> l(lock);
+		auto &normal = lanes[(int)JobPriority::NORMAL];
+		return normal.empty() == false && normal.front().pinned;
+	}
+
+	bool canSteal() override {
+		std::lock_guard<std::mutex> l(lock);
+		return stealableLane() != -1;
+	}
+
+	bool tryStealExternal(Entry &output) override {
+		std::lock_guard<std::mutex> l(lock);
+		if(pinned_count) return false;
+		int lane = stealableLane();
+		if(lane == -1) return false;
+		output = std::move(lanes[lane].front());
+		lanes[lane].pop_front();
+		updateCount();
+		//Under the lock, so a pinned job enqueued after this is dequeued after it too, and its owner sees the count.
+		external_jobs.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	bool canStealExternal() override {
+		std::lock_guard<std::mutex> l(lock);
+		return pinned_count == 0 && stealableLane() != -1;
+	}
+
+	bool empty() override {
+		return job_count.load(std::memory_order_relaxed) == 0;
+	}
+
+	unsigned int size() override {
+		return job_count.load(std::memory_order_relaxed);
+	}
+
+	protected:
+	unsigned int enqueueBatch(Entry* entries, int count) override {
+		std::unique_lock<std::mutex> l(lock);
+		for(int i = 0; i < count; i++) lanes[laneOf(entries[i])].emplace_back(std::move(entries[i]));
+		updateCount();
+		if(owner_sleeping) enqueued_notify.notify_one();
+		return job_count.load(std::memory_order_relaxed);
+	}
+
+	private:
+	//Jobs come from one lane at a time.  A pinned job is always returned alone, and fences the queue until finishPinned.
+	int actualDequeueRange(int count, Entry* output) {
+		bool hasWork[JOB_PRIORITIES];
+		for(int i = 0; i < JOB_PRIORITIES; i++) hasWork[i] = lanes[i].empty() == false;
+		int lane = pickLane(hasWork);
+		if(lane == -1) return 0;
+		auto &queue = lanes[lane];
+		int ret = 0;
+		while(ret < count && queue.empty() == false) {
+			auto &front = queue.front();
+			if(front.pinned) {
+				if(ret) break; //Run what we have first.
+				fenced = true;
+			}
+			output[ret] = std::move(front);
+			queue.pop_front();
+			ret++;
+			if(fenced) break;
+		}
+		updateCount();
+		return ret;
+	}
+
+	//Call with the lock held.
+	void updateCount() {
+		unsigned int total = 0;
+		for(auto &i: lanes) total += i.size();
+		job_count.store(total, std::memory_order_relaxed);
+	}
+
+	//The highest priority lane whose oldest job may be stolen, or -1.
+	int stealableLane() {
+		if(fenced) return -1;
+		for(int i = 0; i < JOB_PRIORITIES; i++) {
+			if(lanes[i].empty() == false && lanes[i].front().pinned == false) return i;
+		}
+		return -1;
+	}
+
+	std::mutex lock;
+	std::deque<Entry> lanes[JOB_PRIORITIES];
+	std::condition_variable enqueued_notify;
+	bool fenced = false, owner_sleeping = false;
+	//Pinned jobs queued or running.
+	int pinned_count = 0;
+	//The total size of the lanes, which can be read without the lock.
+	std::atomic<unsigned int> job_count{0};
+	WaitPolicy wait_policy;
+};
+
+/**A JobQueue built on LockFreeQueue.
+
+Enqueueing and dequeueing never take a lock; the mutex is only used by the owner to sleep when the queue is empty, and producers skip it unless the owner is asleep.
+If the queue is full, enqueue yields until there is room, so the capacity must be large enough for any jobs that jobs themselves submit.
+
+A lock-free queue can't look at a job before taking it, so thieves leave this queue alone from the moment a pinned job is enqueued until it has finished running.
+This gives up stealing around barriers in exchange for lock-free submission.
+
+Every priority has a lane of the full capacity.*/
+class LockFreeJobQueue: public JobQueue {
+	public:
+	LockFreeJobQueue(unsigned int capacity, WaitPolicy waitPolicy = WaitPolicy(), int starvationLimit = 16): JobQueue(starvationLimit), wait_policy(waitPolicy) {
+		for(auto &i: lanes) i.reset(new LockFreeQueue<Entry>(capacity));
+	}
+
+	unsigned int enqueue(Entry entry) override {
+		if(entry.pinned) {
+			//Either a thief sees pinned_pending, or we wait for it to finish the steal it already started.
+			pinned_pending.fetch_add(1);
+			while(stealers.load()) std::this_thread::yield();
+		}
+		auto &queue = *lanes[laneOf(entry)];
+		while(queue.tryEnqueue(std::move(entry)) == false) std::this_thread::yield();
+		wakeOwner();
+		return size();
+	}
+
+	int dequeueRange(int count, Entry* output) override {
+		while(true) {
+			int got = tryDequeueRange(count, output);
+			if(got) return got;
+			if(wait_policy.wait([this] () {return empty() == false;})) continue;
+			std::unique_lock<std::mutex> l(lock);
+			owner_sleeping.store(1);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if(empty()) enqueued_notify.wait(l);
+			owner_sleeping.store(0);
+		}
+	}
+
+	int tryDequeueRange(int count, Entry* output) override {
+		bool hasWork[JOB_PRIORITIES];
+		for(int i = 0; i < JOB_PRIORITIES; i++) hasWork[i] = lanes[i]->empty() == false;
+		int lane = pickLane(hasWork);
+		if(lane == -1) return 0;
+		int got = lanes[lane]->tryDequeueRange(count, output);
+		//A thief may have beaten us to it.
+		for(int i = 0; i < JOB_PRIORITIES && got == 0; i++) got = lanes[i]->tryDequeueRange(count, output);
+		return got;
+	}
+
+	void finishPinned() override {
+		pinned_pending.fetch_sub(1);
+	}
+
+	bool trySteal(Entry &output) override {
+		bool ret = false;
+		stealers.fetch_add(1);
+		for(int i = 0; i < JOB_PRIORITIES && ret == false && pinned_pending.load() == 0; i++) ret = lanes[i]->tryDequeue(output);
+		stealers.fetch_sub(1);
+		return ret;
+	}
+
+	bool pinnedNext() override {
+		return pinned_pending.load() != 0;
+	}
+
+	bool canSteal() override {
+		return pinned_pending.load() == 0 && empty() == false;
+	}
+
+	//trySteal already leaves the queue alone while a pinned job is pending.
+	bool tryStealExternal(Entry &output) override {
+		bool ret = false;
+		stealers.fetch_add(1);
+		for(int i = 0; i < JOB_PRIORITIES && ret == false && pinned_pending.load() == 0; i++) ret = lanes[i]->tryDequeue(output);
+		//Before stealers drops, so the pinned job's enqueue can't complete without the owner seeing the count.
+		if(ret) external_jobs.fetch_add(1);
+		stealers.fetch_sub(1);
+		return ret;
+	}
+
+	bool canStealExternal() override {
+		return canSteal();
+	}
+
+	bool empty() override {
+		for(auto &i: lanes) if(i->empty() == false) return false;
+		return true;
+	}
+
+	unsigned int size() override {
+		unsigned int ret = 0;
+		for(auto &i: lanes) ret += i->size();
+		return ret;
+	}
+
+	protected:
+	//Ranges are always unpinned and NORMAL.
+	unsigned int enqueueBatch(Entry* entries, int count) override {
+		auto &queue = *lanes[(int)JobPriority::NORMAL];
+		while(count) {
+			int got = queue.tryEnqueueRange(std::make_move_iterator(entries), std::make_move_iterator(entries+count));
+			entries += got;
+			count -= got;
+			if(count) std::this_thread::yield();
+		}
+		wakeOwner();
+		return size();
+	}
+
+	private:
+	void wakeOwner() {
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if(owner_sleeping.load(std::memory_order_relaxed)) {
+			std::lock_guard<std::mutex> l(lock);
+			enqueued_notify.notify_one();
+		}
+	}
+
+	std::unique_ptr<LockFreeQueue<Entry>> lanes[JOB_PRIORITIES];
+	std::atomic<int> pinned_pending{0}, stealers{0}, owner_sleeping{0};
+	std::mutex lock;
+	std::condition_variable enqueued_notify;
+	WaitPolicy wait_policy;
+};
+
+}
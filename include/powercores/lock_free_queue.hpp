@@ -0,0 +1,148 @@
+/**This file is part of powercores, released under the terms of the Unlicense.
+See LICENSE in the root of the powercores repository for details.*/
+#pragma once
+#include <atomic>
+#include <utility>
+#include <cstddef>
+#include "utilities.hpp"
+
+namespace powercores {
+
+/**A fixed-capacity lock-free queue supporting any number of readers and writers.
+
+This is a ring buffer in which every cell carries a sequence number saying whose turn it is to use the cell (Dmitry Vyukov's bounded MPMC queue).
+Producers and consumers each claim positions with one compare-and-swap on their own counter, and the two counters live on separate cache lines.
+Nothing is allocated after construction.
+
+Unlike ThreadsafeQueue, nothing here sleeps: tryEnqueue fails if the queue is full and tryDequeue fails if it is empty.
+
+Note: T must be default constructible and move assignable.*/
+template <typename T>
+class LockFreeQueue {
+	public:
+	/**Make a queue holding at most capacity items.  The capacity is rounded up to a power of two.*/
+	LockFreeQueue(unsigned int capacity) {
+		std::size_t actual = 2;
+		while(actual < capacity) actual *= 2;
+		mask = actual-1;
+		cells = new Cell[actual];
+		for(std::size_t i = 0; i < actual; i++) cells[i].sequence.store(i, std::memory_order_relaxed);
+		enqueue_pos.store(0, std::memory_order_relaxed);
+		dequeue_pos.store(0, std::memory_order_release);
+	}
+
+	~LockFreeQueue() {
+		delete[] cells;
+	}
+
+	LockFreeQueue(const LockFreeQueue&) = delete;
+	LockFreeQueue& operator=(const LockFreeQueue&) = delete;
+
+	/**Enqueue an item, returning false if the queue is full.
+	On failure, item is left untouched.*/
+	template<typename U>
+	bool tryEnqueue(U&& item) {
+		std::size_t pos;
+		if(claim(enqueue_pos, 1, 0, pos) == 0) return false;
+		Cell &cell = cells[pos&mask];
+		cell.data = std::forward<U>(item);
+		cell.sequence.store(pos+1, std::memory_order_release);
+		return true;
+	}
+
+	/**Dequeue an item into output, returning false if the queue is empty.*/
+	bool tryDequeue(T &output) {
+		std::size_t pos;
+		if(claim(dequeue_pos, 1, 1, pos) == 0) return false;
+		Cell &cell = cells[pos&mask];
+		output = std::move(cell.data);
+		cell.sequence.store(pos+mask+1, std::memory_order_release);
+		return true;
+	}
+
+	/**Enqueue as much of the range represented by begin and end as will fit, claiming all the space with one compare-and-swap.
+	Returns the number of items enqueued, which are always the first ones in the range.*/
+	template<class IterT>
+	int tryEnqueueRange(IterT begin, IterT end) {
+		std::size_t pos;
+		int got = claim(enqueue_pos, end-begin, 0, pos);
+		for(int i = 0; i < got; i++, begin++) {
+			Cell &cell = cells[(pos+i)&mask];
+			cell.data = *begin;
+			cell.sequence.store(pos+i+1, std::memory_order_release);
+		}
+		return got;
+	}
+
+	/**Dequeue at most count items, storing them in the iterator.
+	Returns the number of items dequeued, which is 0 if the queue is empty.*/
+	template<class IterT>
+	int tryDequeueRange(int count, IterT output) {
+		std::size_t pos;
+		int got = claim(dequeue_pos, count, 1, pos);
+		for(int i = 0; i < got; i++, output++) {
+			Cell &cell = cells[(pos+i)&mask];
+			*output = std::move(cell.data);
+			cell.sequence.store(pos+i+mask+1, std::memory_order_release);
+		}
+		return got;
+	}
+
+	/**Get the number of items in the queue.
+	With other threads using the queue, this is only a snapshot.*/
+	unsigned int size() {
+		std::size_t d = dequeue_pos.load(std::memory_order_relaxed);
+		std::size_t e = enqueue_pos.load(std::memory_order_relaxed);
+		return e > d ? (unsigned int)(e-d) : 0;
+	}
+
+	bool empty() {
+		return size() == 0;
+	}
+
+	unsigned int capacity() {
+		return (unsigned int)(mask+1);
+	}
+
+	private:
+	struct Cell {
+		std::atomic<std::size_t> sequence;
+		T data;
+	};
+
+	/*Claim up to count consecutive positions from position.
+	A cell is ready when its sequence is its position plus offset: 0 for producers, 1 for consumers.
+	We claim the ready prefix with one CAS; nobody else can use those cells until position moves past them, and we are the ones moving it.*/
+	int claim(std::atomic<std::size_t> &position, int count, std::size_t offset, std::size_t &pos) {
+		pos = position.load(std::memory_order_relaxed);
+		while(count > 0) {
+			int ready = 0;
+			std::ptrdiff_t diff = 0;
+			while(ready < count) {
+				std::size_t seq = cells[(pos+ready)&mask].sequence.load(std::memory_order_acquire);
+				diff = (std::ptrdiff_t)(seq-(pos+ready+offset));
+				if(diff != 0) break;
+				ready++;
+			}
+			if(ready) {
+				if(position.compare_exchange_weak(pos, pos+ready, std::memory_order_relaxed)) return ready;
+			}
+			//The first cell is a full lap behind: we're full (producers) or empty (consumers).
+			else if(diff < 0) return 0;
+			//Someone else claimed it first.
+			else pos = position.load(std::memory_order_relaxed);
+		}
+		return 0;
+	}
+
+	char pad0[CACHE_LINE_SIZE];
+	Cell* cells;
+	std::size_t mask;
+	char pad1[CACHE_LINE_SIZE];
+	std::atomic<std::size_t> enqueue_pos;
+	char pad2[CACHE_LINE_SIZE];
+	std::atomic<std::size_t> dequeue_pos;
+	char pad3[CACHE_LINE_SIZE];
+};
+
+}
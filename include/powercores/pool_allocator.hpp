@@ -0,0 +1,111 @@
+/**This file is part of powercores, released under the terms of the Unlicense.
+See LICENSE in the root of the powercores repository for details.*/
+#pragma once
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <type_traits>
+
+namespace powercores {
+
+/**Allocate size bytes from the calling thread's pool.
+
+Blocks of up to POOL_ALLOCATOR_MAX_SIZE bytes come from per-thread freelists, one per power-of-two size class, so allocating and freeing on one thread takes no locks and no atomics.
+A block freed on a thread other than the one which allocated it goes back to its owner on a lock-free list, which the owner picks up the next time its own freelist runs dry.  This is the usual pattern for jobs: allocated by the submitter, freed by a worker.
+Such blocks are gathered on the freeing thread and handed back 32 at a time, so a freeing thread may hold a few blocks of another thread's until it frees more, frees for a different thread, or exits.
+Larger blocks go straight to the global operator new.
+Each list keeps at most 512 KB of blocks; beyond that, blocks are returned to the global heap.
+When a thread exits, its free blocks are released, and blocks it still has out are returned to whichever thread next takes over its pool.
+
+Memory is aligned for any standard type, but not for over-aligned ones.  Free it with poolFree, from any thread.*/
+void* poolAllocate(std::size_t size);
+void poolFree(void* block);
+
+const std::size_t POOL_ALLOCATOR_MAX_SIZE = 2048;
+
+//Internal helpers for poolNew and poolDelete, do not use.
+template<typename T, typename... ArgsT>
+T* poolNewImpl(std::true_type, ArgsT&&... args) {
+	void* block = poolAllocate(sizeof(T));
+	try {
+		return new(block) T(std::forward<ArgsT>(args)...);
+	}
+	catch(...) {
+		poolFree(block);
+		throw;
+	}
+}
+
+template<typename T, typename... ArgsT>
+T* poolNewImpl(std::false_type, ArgsT&&... args) {
+	return new T(std::forward<ArgsT>(args)...);
+}
+
+template<typename T>
+void poolDeleteImpl(std::true_type, T* p) {
+	p->~T();
+	poolFree(p);
+}
+
+template<typename T>
+void poolDeleteImpl(std::false_type, T* p) {
+	delete p;
+}
+
+template<typename T>
+using PoolCanHold = std::integral_constant<bool, alignof(T) <= alignof(std::max_align_t)>;
+
+/**new, from the pool.  Over-aligned types fall back to the global new.*/
+template<typename T, typename... ArgsT>
+T* poolNew(ArgsT&&... args) {
+	return poolNewImpl<T>(PoolCanHold<T>(), std::forward<ArgsT>(args)...);
+}
+
+/**delete, for objects from poolNew.  Unlike with poolFree, p must point to the complete object, not a base.*/
+template<typename T>
+void poolDelete(T* p) {
+	if(p) poolDeleteImpl(PoolCanHold<T>(), p);
+}
+
+/**Inherit from this to allocate a class with new and delete from the pool.
+Deleting through a base pointer works, since blocks don't need their size to be freed.*/
+class PoolAllocated {
+	public:
+	static void* operator new(std::size_t size) {
+		return poolAllocate(size);
+	}
+	static void operator delete(void* p) {
+		poolFree(p);
+	}
+};
+
+/**A standard allocator on the pool, for containers of per-block scratch data and for std::allocate_shared.*/
+template<typename T>
+class PoolAllocator {
+	public:
+	typedef T value_type;
+
+	PoolAllocator() {}
+	template<typename U>
+	PoolAllocator(const PoolAllocator<U> &) {}
+
+	T* allocate(std::size_t n) {
+		return static_cast<T*>(poolAllocate(n*sizeof(T)));
+	}
+
+	void deallocate(T* p, std::size_t) {
+		poolFree(p);
+	}
+};
+
+template<typename T, typename U>
+bool operator==(const PoolAllocator<T> &, const PoolAllocator<U> &) {
+	return true;
+}
+
+template<typename T, typename U>
+bool operator!=(const PoolAllocator<T> &, const PoolAllocator<U> &) {
+	return false;
+}
+
+}
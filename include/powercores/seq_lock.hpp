@@ -0,0 +1,99 @@
+/**This file is part of powercores, released under the terms of the Unlicense.
+See LICENSE in the root of the powercores repository for details.*/
+#pragma once
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+#include "utilities.hpp"
+
+namespace powercores {
+
+/**Publishes a value from one writing thread to any number of reading threads, such as a set of filter coefficients from the control thread to the audio workers.
+
+Readers always get a complete copy of the latest value, without locking or allocating, and the writer never waits for them.
+There are two copies of the value, and the writer fills whichever one readers aren't being pointed at before switching them over.  Each copy has a sequence number, which is odd while it's being written; a reader copies the value out and then checks that the number didn't change, and if it did, reads again.
+Because of the second copy, a reader only has to retry if the writer writes twice while it is copying, so even large values are read in one go almost every time.
+
+Readers are lock-free and the writer is wait-free.  Both sides are safe from pool jobs and realtime threads.
+Reading copies the whole value; use readIfNewer to skip the copy when nothing has changed since the last read.
+
+Note: T must be trivially copyable, since readers may copy it while it's being overwritten and then throw the copy away.  Only one thread may write.*/
+template<typename T>
+class SeqLock {
+	static_assert(std::is_trivially_copyable<T>::value, "SeqLock needs a trivially copyable type.");
+
+	public:
+	SeqLock(const T &initial = T()) {
+		for(auto &i: copies) {
+			std::memcpy(&i.value, &initial, sizeof(T));
+			i.sequence.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	SeqLock(const SeqLock&) = delete;
+	SeqLock& operator=(const SeqLock&) = delete;
+
+	/**Writer side.  Publish a new value.*/
+	void write(const T &value) {
+		int next = 1-current.load(std::memory_order_relaxed);
+		auto &copy = copies[next];
+		auto seq = copy.sequence.load(std::memory_order_relaxed);
+		copy.sequence.store(seq+1, std::memory_order_relaxed);
+		//Readers who see the new value must see the odd sequence number first.
+		std::atomic_thread_fence(std::memory_order_release);
+		std::memcpy(&copy.value, &value, sizeof(T));
+		copy.sequence.store(seq+2, std::memory_order_release);
+		current.store(next, std::memory_order_release);
+		version.store(version.load(std::memory_order_relaxed)+1, std::memory_order_release);
+	}
+
+	/**Reader side.  Copy the latest value into output.*/
+	void read(T &output) {
+		while(true) {
+			auto &copy = copies[current.load(std::memory_order_acquire)];
+			auto before = copy.sequence.load(std::memory_order_acquire);
+			if(before & 1) {
+				//The writer has lapped us and is rewriting this copy; the other one is complete.
+				cpuRelax();
+				continue;
+			}
+			std::memcpy(&output, &copy.value, sizeof(T));
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if(copy.sequence.load(std::memory_order_relaxed) == before) return;
+		}
+	}
+
+	T read() {
+		T ret;
+		read(ret);
+		return ret;
+	}
+
+	/**Reader side.  If there has been a write since version seen, copy the latest value into output, update seen, and return true.  Start seen at 0.*/
+	bool readIfNewer(T &output, unsigned long long &seen) {
+		auto v = version.load(std::memory_order_acquire);
+		if(v == seen) return false;
+		read(output);
+		seen = v;
+		return true;
+	}
+
+	/**How many times the value has been written.*/
+	unsigned long long getVersion() {
+		return version.load(std::memory_order_acquire);
+	}
+
+	private:
+	struct Copy {
+		std::atomic<unsigned long long> sequence;
+		T value;
+		char pad[CACHE_LINE_SIZE];
+	};
+
+	std::atomic<int> current{0};
+	std::atomic<unsigned long long> version{0};
+	char pad[CACHE_LINE_SIZE];
+	Copy copies[2];
+};
+
+}
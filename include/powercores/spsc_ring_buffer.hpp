@@ -0,0 +1,150 @@
+/**This file is part of powercores, released under the terms of the Unlicense.
+See LICENSE in the root of the powercores repository for details.*/
+#pragma once
+#include <atomic>
+#include <algorithm>
+#include <cstddef>
+#include "utilities.hpp"
+
+namespace powercores {
+
+/**A ring buffer with exactly one writing thread and exactly one reading thread.
+
+Every operation is wait-free: nothing loops, locks, sleeps, or allocates after construction, so both ends are safe to use from a realtime audio callback.
+Each side owns one index on its own cache line and keeps a cached copy of the other side's index, so the common case touches no shared cache lines at all.
+
+Data moves in bulk.  write and read copy whole runs with std::copy, which is memmove for trivially copyable types like samples.
+To avoid even that copy, beginWrite and beginRead hand out the buffer's own memory as at most two contiguous pieces, which are then given back with endWrite and endRead.
+
+Note: T must be default constructible and copy assignable.*/
+template <typename T>
+class SpscRingBuffer {
+	public:
+	/**Two contiguous pieces of the buffer.
+	second_size is 0 unless the region wraps around the end of the buffer.*/
+	struct Regions {
+		T* first = nullptr;
+		unsigned int first_size = 0;
+		T* second = nullptr;
+		unsigned int second_size = 0;
+		unsigned int size() {return first_size+second_size;}
+	};
+
+	/**Make a ring buffer holding at most capacity items.  The capacity is rounded up to a power of two.*/
+	SpscRingBuffer(unsigned int capacity) {
+		std::size_t actual = 2;
+		while(actual < capacity) actual *= 2;
+		mask = actual-1;
+		buffer = new T[actual];
+	}
+
+	~SpscRingBuffer() {
+		delete[] buffer;
+	}
+
+	SpscRingBuffer(const SpscRingBuffer&) = delete;
+	SpscRingBuffer& operator=(const SpscRingBuffer&) = delete;
+
+	/**Writer side.  Write one item, returning false if the buffer is full.*/
+	bool tryWrite(const T &item) {
+		auto r = beginWrite(1);
+		if(r.first_size == 0) return false;
+		*r.first = item;
+		endWrite(1);
+		return true;
+	}
+
+	/**Writer side.  Write at most count items from data, returning how many were written.*/
+	unsigned int write(const T* data, unsigned int count) {
+		auto r = beginWrite(count);
+		std::copy(data, data+r.first_size, r.first);
+		std::copy(data+r.first_size, data+r.size(), r.second);
+		endWrite(r.size());
+		return r.size();
+	}
+
+	/**Writer side.  Get space for at most count items, without publishing anything.
+	Fill in some prefix of the regions, then call endWrite with how many items were filled in.*/
+	Regions beginWrite(unsigned int count) {
+		std::size_t t = write_index.load(std::memory_order_relaxed);
+		if(capacity()-(t-cached_read_index) < count) cached_read_index = read_index.load(std::memory_order_acquire);
+		return regionsAt(t, std::min<std::size_t>(count, capacity()-(t-cached_read_index)));
+	}
+
+	/**Writer side.  Publish count items written after beginWrite.*/
+	void endWrite(unsigned int count) {
+		write_index.store(write_index.load(std::memory_order_relaxed)+count, std::memory_order_release);
+	}
+
+	/**Reader side.  Read one item, returning false if the buffer is empty.*/
+	bool tryRead(T &output) {
+		auto r = beginRead(1);
+		if(r.first_size == 0) return false;
+		output = *r.first;
+		endRead(1);
+		return true;
+	}
+
+	/**Reader side.  Read at most count items into output, returning how many were read.*/
+	unsigned int read(T* output, unsigned int count) {
+		auto r = beginRead(count);
+		std::copy(r.first, r.first+r.first_size, output);
+		std::copy(r.second, r.second+r.second_size, output+r.first_size);
+		endRead(r.size());
+		return r.size();
+	}
+
+	/**Reader side.  Get at most count readable items, without consuming them.
+	Consume some prefix with endRead.*/
+	Regions beginRead(unsigned int count) {
+		std::size_t h = read_index.load(std::memory_order_relaxed);
+		if(cached_write_index-h < count) cached_write_index = write_index.load(std::memory_order_acquire);
+		return regionsAt(h, std::min<std::size_t>(count, cached_write_index-h));
+	}
+
+	/**Reader side.  Release count items read after beginRead back to the writer.*/
+	void endRead(unsigned int count) {
+		read_index.store(read_index.load(std::memory_order_relaxed)+count, std::memory_order_release);
+	}
+
+	/**How many items the reader could read right now.  Exact on the reader thread; a snapshot anywhere else.*/
+	unsigned int readAvailable() {
+		return (unsigned int)(write_index.load(std::memory_order_acquire)-read_index.load(std::memory_order_relaxed));
+	}
+
+	/**How many items the writer could write right now.  Exact on the writer thread; a snapshot anywhere else.*/
+	unsigned int writeAvailable() {
+		return capacity()-(unsigned int)(write_index.load(std::memory_order_relaxed)-read_index.load(std::memory_order_acquire));
+	}
+
+	unsigned int capacity() {
+		return (unsigned int)(mask+1);
+	}
+
+	private:
+	Regions regionsAt(std::size_t index, std::size_t count) {
+		Regions r;
+		std::size_t start = index&mask;
+		std::size_t firstSize = std::min(count, mask+1-start);
+		r.first = buffer+start;
+		r.first_size = (unsigned int)firstSize;
+		r.second = buffer;
+		r.second_size = (unsigned int)(count-firstSize);
+		return r;
+	}
+
+	char pad0[CACHE_LINE_SIZE];
+	T* buffer;
+	std::size_t mask;
+	char pad1[CACHE_LINE_SIZE];
+	//Owned by the writer.
+	std::atomic<std::size_t> write_index{0};
+	std::size_t cached_read_index = 0;
+	char pad2[CACHE_LINE_SIZE];
+	//Owned by the reader.
+	std::atomic<std::size_t> read_index{0};
+	std::size_t cached_write_index = 0;
+	char pad3[CACHE_LINE_SIZE];
+};
+
+}
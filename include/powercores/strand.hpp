@@ -0,0 +1,84 @@
+/**This file is part of powercores, released under the terms of the Unlicense.
+See LICENSE in the root of the powercores repository for details.*/
+#pragma once
+#include <atomic>
+#include <utility>
+#include <type_traits>
+#include "task.hpp"
+#include "future.hpp"
+#include "job_queue.hpp"
+#include "pool_allocator.hpp"
+#include "utilities.hpp"
+
+namespace powercores {
+
+class ThreadPool;
+
+//Internal to Strand, do not use.
+class StrandNode: public PoolAllocated {
+	public:
+	StrandNode() {}
+	StrandNode(Task j): job(std::move(j)) {}
+	std::atomic<StrandNode*> next{nullptr};
+	Task job;
+};
+
+/**Runs jobs one at a time, in the order they were submitted, on the workers of a ThreadPool.
+
+Use this instead of a mutex in every job, or a barrier around every job, for state which needs its updates in order, such as a stream or a device.
+A strand has no thread of its own: while it has jobs, one job on the pool drains it, and when it runs dry that job ends.  Any number of strands can share a pool.
+After 32 jobs in a row, the strand resubmits itself, so a busy strand doesn't keep other work off its worker.
+
+Submission is lock-free, onto an unbounded queue whose nodes come from the pool allocator.
+Jobs submitted by one thread run in the order that thread submitted them, and never overlap with each other or with any other job of the strand.
+If a job throws, the exception goes to the pool's exception handler as it would from any job, and the strand carries on with its next job.
+
+The destructor waits until the strand is empty, so don't destroy a strand from one of its own jobs.*/
+class Strand {
+	public:
+	Strand(ThreadPool &pool, JobPriority priority = JobPriority::NORMAL);
+	~Strand();
+	Strand(const Strand&) = delete;
+	Strand& operator=(const Strand&) = delete;
+
+	/**Submit a job.  Named like ThreadPool's, so that Future::then can run continuations on a strand.*/
+	template<typename CallableT>
+	void submitJob(CallableT &&job) {
+		enqueue(new StrandNode(Task(std::forward<CallableT>(job))));
+	}
+
+	/**Submit a job and get a Future for its result.*/
+	template<class FuncT, class... ArgsT>
+	Future<typename std::result_of<FuncT(ArgsT...)>::type> submitJobWithFuture(FuncT &&callable, ArgsT&&... args) {
+		typedef typename std::result_of<FuncT(ArgsT...)>::type ResultT;
+		Promise<ResultT> promise;
+		auto retval = promise.getFuture();
+		submitJob([promise = std::move(promise), callable = typename std::decay<FuncT>::type(std::forward<FuncT>(callable)), args...] () mutable {
+			FutureFulfil<ResultT>::run(promise, [&] () {return callable(args...);});
+		});
+		return retval;
+	}
+
+	/**True if no jobs are waiting or running.*/
+	bool empty();
+
+	private:
+	void enqueue(StrandNode* node);
+	void push(StrandNode* node);
+	//Consumer side; only the runner calls this.  Returns nullptr if a producer is midway through a push.
+	StrandNode* pop();
+	void schedule();
+	void run();
+
+	ThreadPool &pool;
+	JobPriority priority;
+	//An intrusive multi-producer single-consumer queue: producers swap themselves into head, and the runner follows next pointers from tail.
+	StrandNode stub;
+	std::atomic<StrandNode*> head;
+	char pad[CACHE_LINE_SIZE];
+	StrandNode* tail;
+	//Jobs submitted but not yet finished.  Whoever moves this from 0 to 1 starts the runner, so there is never more than one.
+	std::atomic<int> pending{0};
+};
+
+}
@@ -0,0 +1,135 @@
+/**This file is part of powercores, released under the terms of the Unlicense.
+See LICENSE in the root of the powercores repository for details.*/
+#pragma once
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <type_traits>
+#include "pool_allocator.hpp"
+
+namespace powercores {
+
+/**A move-only void() callable, used as the job type of ThreadPool.
+
+Unlike std::function, a Task never copies and can hold move-only callables such as lambdas which capture a std::packaged_task or a std::unique_ptr.
+Any callable of at most INLINE_SIZE bytes which can be moved without throwing is stored inside the Task itself, so creating, moving and running it never touch the heap.
+Larger callables are moved to the calling thread's pool (see poolAllocate), since they are usually freed by a worker.*/
+class Task {
+	public:
+	/**Callables up to this size are stored inline.  This is enough for a lambda capturing eight pointers.*/
+	static const std::size_t INLINE_SIZE = 64;
+
+	Task() {}
+	Task(std::nullptr_t) {}
+
+	template<typename CallableT, typename = typename std::enable_if<std::is_same<typename std::decay<CallableT>::type, Task>::value == false>::type>
+	Task(CallableT &&callable) {
+		typedef typename std::decay<CallableT>::type F;
+		construct<F>(std::forward<CallableT>(callable), std::integral_constant<bool, fitsInline<F>()>());
+	}
+
+	Task(Task &&other) noexcept {
+		moveFrom(other);
+	}
+
+	Task& operator=(Task &&other) noexcept {
+		if(this != &other) {
+			reset();
+			moveFrom(other);
+		}
+		return *this;
+	}
+
+	Task& operator=(std::nullptr_t) {
+		reset();
+		return *this;
+	}
+
+	Task(const Task&) = delete;
+	Task& operator=(const Task&) = delete;
+
+	~Task() {
+		reset();
+	}
+
+	void operator()() {
+		ops->invoke(&storage);
+	}
+
+	explicit operator bool() const {
+		return ops != nullptr;
+	}
+
+	/**True if the callable is stored inside the Task rather than on the heap.*/
+	bool isInline() const {
+		return ops != nullptr && ops->is_inline;
+	}
+
+	private:
+	struct Ops {
+		void (*invoke)(void* storage);
+		//Move-construct into to from from, and destroy from.
+		void (*relocate)(void* from, void* to);
+		void (*destroy)(void* storage);
+		bool is_inline;
+	};
+
+	template<typename F>
+	static constexpr bool fitsInline() {
+		return sizeof(F) <= INLINE_SIZE && alignof(F) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible<F>::value;
+	}
+
+	template<typename F>
+	struct InlineOps {
+		static void invoke(void* s) {(*static_cast<F*>(s))();}
+		static void relocate(void* from, void* to) {
+			new(to) F(std::move(*static_cast<F*>(from)));
+			static_cast<F*>(from)->~F();
+		}
+		static void destroy(void* s) {static_cast<F*>(s)->~F();}
+		static const Ops ops;
+	};
+
+	template<typename F>
+	struct HeapOps {
+		static void invoke(void* s) {(**static_cast<F**>(s))();}
+		static void relocate(void* from, void* to) {*static_cast<F**>(to) = *static_cast<F**>(from);}
+		static void destroy(void* s) {poolDelete(*static_cast<F**>(s));}
+		static const Ops ops;
+	};
+
+	template<typename F, typename CallableT>
+	void construct(CallableT &&callable, std::true_type) {
+		new(&storage) F(std::forward<CallableT>(callable));
+		ops = &InlineOps<F>::ops;
+	}
+
+	template<typename F, typename CallableT>
+	void construct(CallableT &&callable, std::false_type) {
+		*reinterpret_cast<F**>(&storage) = poolNew<F>(std::forward<CallableT>(callable));
+		ops = &HeapOps<F>::ops;
+	}
+
+	void moveFrom(Task &other) {
+		if(other.ops == nullptr) return;
+		other.ops->relocate(&other.storage, &storage);
+		ops = other.ops;
+		other.ops = nullptr;
+	}
+
+	void reset() {
+		if(ops) ops->destroy(&storage);
+		ops = nullptr;
+	}
+
+	typename std::aligned_storage<INLINE_SIZE, alignof(std::max_align_t)>::type storage;
+	const Ops* ops = nullptr;
+};
+
+template<typename F>
+const Task::Ops Task::InlineOps<F>::ops = {&Task::InlineOps<F>::invoke, &Task::InlineOps<F>::relocate, &Task::InlineOps<F>::destroy, true};
+
+template<typename F>
+const Task::Ops Task::HeapOps<F>::ops = {&Task::HeapOps<F>::invoke, &Task::HeapOps<F>::relocate, &Task::HeapOps<F>::destroy, false};
+
+}
@@ -0,0 +1,74 @@
+/**This file is part of powercores, released under the terms of the Unlicense.
+See LICENSE in the root of the powercores repository for details.*/
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <vector>
+#include "task.hpp"
+
+namespace powercores {
+
+class ThreadPool;
+
+/**A graph of jobs with dependencies, which can be run on a ThreadPool over and over.
+
+Add nodes and edges, call compile once, then call run as many times as needed.
+A node starts as soon as all of its predecessors have finished, so unrelated branches run in parallel without barriers.
+compile precomputes everything a run needs, including each node's dependency count, so running the graph allocates nothing beyond what submitting a small job to the pool does.
+When a node finishes and releases several successors, the worker runs one of them itself and submits the rest, which keeps a chain of nodes on one core.
+
+The graph must not be changed or run again while a run is in progress.*/
+class TaskGraph {
+	public:
+	TaskGraph() = default;
+	TaskGraph(const TaskGraph&) = delete;
+	TaskGraph& operator=(const TaskGraph&) = delete;
+
+	/**Add a node, returning its id.  The job is called once per run.*/
+	template<typename CallableT>
+	int addNode(CallableT &&job) {
+		nodes.emplace_back(std::forward<CallableT>(job));
+		compiled = false;
+		return (int)nodes.size()-1;
+	}
+
+	/**Make to wait for from.  Throws std::out_of_range for ids which don't exist.*/
+	void addEdge(int from, int to);
+
+	/**Build the plan for running the graph.  Throws CycleException if the edges form a cycle.
+	run calls this if the graph has changed since the last call.*/
+	void compile();
+
+	/**Run every node once on pool, and wait for them all to finish.
+	If a node throws, nodes which have not yet started are skipped and the first exception is rethrown here.*/
+	void run(ThreadPool &pool);
+
+	/**Like run, but returns immediately.  Use wait to wait for the run to finish.*/
+	void start(ThreadPool &pool);
+	void wait();
+
+	int getNodeCount();
+
+	private:
+	void runNode(int node);
+
+	std::vector<Task> nodes;
+	std::vector<std::pair<int, int>> edges;
+	bool compiled = false;
+	//The plan: successors in compressed form (node i's are successors[successor_offsets[i]] to successors[successor_offsets[i+1]]), and how many predecessors each node waits for.
+	std::vector<int> successor_offsets, successors, predecessor_counts, roots;
+	//Per-run state.
+	std::unique_ptr<std::atomic<int>[]> pending;
+	std::atomic<int> remaining{0};
+	std::atomic<bool> failed{false};
+	std::exception_ptr error;
+	ThreadPool* pool = nullptr;
+	bool done = true;
+	std::mutex done_lock;
+	std::condition_variable done_notify;
+};
+
+}
@@ -2,84 +2,126 @@
 See LICENSE in the root of the powercores repository for details.*/
 #pragma once
 #include "utilities.hpp"
+#include "pool_allocator.hpp"
 #include <atomic>
 #include <thread>
 #include <system_error>
 #include <utility>
 #include <functional>
-#include <unordered_map>
+#include <memory>
 #include <vector>
 
 namespace powercores {
 
+//Internal helpers for ThreadLocalVariable, do not use.
+//Every variable gets an index into a per-thread table of slots, plus a generation which is never reused.
+//A slot belongs to a variable only if the generations match, so a thread can't see a value left behind by a dead variable which had the same index.
+class ThreadLocalValueBase: public PoolAllocated {
+	public:
+	virtual ~ThreadLocalValueBase() {}
+};
+
+class ThreadLocalSlot {
+	public:
+	unsigned long long generation = 0;
+	void* value = nullptr;
+	//Owns value, and deletes it with the variable's deleter.
+	ThreadLocalValueBase* owner = nullptr;
+};
+
+class ThreadLocalSlotTable {
+	public:
+	std::vector<ThreadLocalSlot> slots;
+};
+
+//The calling thread's table, or nullptr before its first access to any variable.
+//A trivially destructible pointer with a constant initializer, so reading it is a plain TLS load, with no call to the compiler's thread_local initialization wrapper.
+inline ThreadLocalSlotTable*& threadLocalSlotTable() {
+	static thread_local ThreadLocalSlotTable* table = nullptr;
+	return table;
+}
+
+//Creates the calling thread's table, and arranges for it and every value in it to be deleted at thread exit.
+ThreadLocalSlotTable* createThreadLocalSlotTable();
+void allocateThreadLocalSlot(unsigned int &index, unsigned long long &generation);
+void freeThreadLocalSlot(unsigned int index);
+
+template<typename T>
+class ThreadLocalValue: public ThreadLocalValueBase {
+	public:
+	ThreadLocalValue(T* v, const std::function<void(T*)> &d): value(v), deleter(d) {}
+	~ThreadLocalValue() {
+		deleter(value);
+	}
+	T* value;
+	std::function<void(T*)> deleter;
+};
+
 /**A thread-local variable. Get the value by dereferencing with *.
--> also works, if and only if the contained type implements ->.*/
+-> also works, if and only if the contained type implements ->.
+
+After a thread's first access, dereferencing is a bounds check and two loads from a table owned by the calling thread; no shared state is touched.
+Values are deleted with the deleter when the thread which created them exits.*/
 template<typename T>
 class ThreadLocalVariable {
 	public:
-	//Create a ThreadLocalVariable, and default construct the contents.
-	ThreadLocalVariable(): ThreadLocalVariable([] () {return new T();}) {}
+	//Create a ThreadLocalVariable, and default construct the contents, from the pool allocator.
+	ThreadLocalVariable(): ThreadLocalVariable([] () {return poolNew<T>();}, [] (T* i) {poolDelete(i);}) {}
 	/*Create a thread-local variable with a  custom construction function.
 	This function will be called on the first access from any thread that does not yet have a value for the vaeriable.*/
 	ThreadLocalVariable(std::function<T*(void)> creator): ThreadLocalVariable(creator, [](T* i) {delete i;}) {}
-	
+
 	/**Create  a thread-local variable with custom creator and deleter.
 	The creator is called on the first access from any thread which has not used the variable before.
 	The deleter is called from threads which have used the variable, and must obey the same limitations as a destructor (i.e. don't throw exceptions).*/
 	ThreadLocalVariable(std::function<T*(void)> creator, std::function<void(T*)> deleter) {
 		this->creator = creator;
 		this->deleter = deleter;
-		map_atomic.store(&map);
+		allocateThreadLocalSlot(index, generation);
 	}
-	
+
+	/**Values already created stay alive until their threads exit, as they always have.*/
+	~ThreadLocalVariable() {
+		freeThreadLocalSlot(index);
+	}
+
+	ThreadLocalVariable(const ThreadLocalVariable&) = delete;
+	ThreadLocalVariable& operator=(const ThreadLocalVariable&) = delete;
+
 	T& operator*() {
-		auto id = getThreadId();
-		acquireMap();
-		int had = map.count(id);
-		auto weak = map[id];
-		releaseMap();
-		auto strong = weak.lock();
-		//Do we need to create?
-		if(had == 0 || strong == nullptr) {
-			auto ptr = creator();
-			auto deleter = this->deleter; //So we can capture a copy.
-			strong = std::shared_ptr<T>(ptr, [deleter](void* p){deleter(static_cast<T*>(p));});
-			//The weak pointer will die when the thread does.
-			local_strong_references.push_back(strong);
-			acquireMap();
-			map[id] = strong;
-			releaseMap();
-		}
-		return *strong;
+		auto table = threadLocalSlotTable();
+		if(table && index < table->slots.size() && table->slots[index].generation == generation) return *static_cast<T*>(table->slots[index].value);
+		return create();
 	}
-	
+
 	T& operator->() {
 		//Return the result of dereferencing ourself. This works because we're a parameterless template.
 		return **this;
 	}
-	
+
 	private:
-	void acquireMap() {
-		//If we read not-nullptr then it's ours, otherwise we're spin waiting for another thread to give us the map.
-		while(map_atomic.exchange(nullptr, std::memory_order_acquire) == nullptr) {
-			std::this_thread::yield();
-		}
-	}
-	
-	void releaseMap() {
-		//We assume we acquired first. So just:
-		map_atomic.store(&map, std::memory_order_release);
+	//The slow path: the first access from this thread.
+	T& create() {
+		auto table = threadLocalSlotTable();
+		if(table == nullptr) table = createThreadLocalSlotTable();
+		auto &slots = table->slots;
+		if(index >= slots.size()) slots.resize(index+1);
+		auto ptr = creator();
+		auto owner = new ThreadLocalValue<T>(ptr, deleter);
+		auto &slot = slots[index];
+		//Left behind by a dead variable which had our index.
+		auto old = slot.owner;
+		slot.generation = generation;
+		slot.value = ptr;
+		slot.owner = owner;
+		delete old;
+		return *ptr;
 	}
-	
-	std::atomic<std::unordered_map<long long, std::weak_ptr<T>>*> map_atomic{nullptr};
-	std::unordered_map<long long, std::weak_ptr<T>> map;
+
+	unsigned int index;
+	unsigned long long generation;
 	std::function<T*(void)> creator;
 	std::function<void(T*)> deleter;
-	//When this goes out of scope, the references break.
-	thread_local static std::vector<std::shared_ptr<T>> local_strong_references;
 };
 
-template<typename T>
-thread_local std::vector<std::shared_ptr<T>> ThreadLocalVariable<T>::local_strong_references;
-
-}
\ No newline at end of file
+}
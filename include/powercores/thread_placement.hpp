@@ -0,0 +1,48 @@
+/**This file is part of powercores, released under the terms of the Unlicense.
+See LICENSE in the root of the powercores repository for details.*/
+#pragma once
+#include <vector>
+
+namespace powercores {
+
+/**A logical CPU, numbered as the operating system numbers them.*/
+class CpuInfo {
+	public:
+	int id = 0;
+	/**Logical CPUs with the same core and package are hyperthreads of one physical core.*/
+	int core = 0, package = 0;
+	int numa_node = 0;
+};
+
+/**Which logical CPUs share a core, a package, and a NUMA node.
+
+On Linux this is read from sysfs.  Elsewhere, or if sysfs can't be read, every CPU is its own core on package 0 and node 0.*/
+class CpuTopology {
+	public:
+	static CpuTopology detect();
+
+	/**CPUs ordered so that taking them from the front spreads threads as widely as possible.
+	Packages are taken in turn, each thread gets a physical core of its own, and second hyperthreads come only after every core has one thread.*/
+	std::vector<int> spreadOrder() const;
+
+	std::vector<CpuInfo> cpus;
+};
+
+enum class ThreadScheduling {
+	/**Leave the thread as the operating system made it.*/
+	DEFAULT,
+	/**A nice value, from -20 (most favored) to 19.  Lowering it below the process's usually needs privileges.*/
+	NICE,
+	/**Realtime first-in first-out scheduling, with a priority from 1 to 99.  This usually needs privileges, for example CAP_SYS_NICE or an rtprio limit.*/
+	FIFO,
+};
+
+/**Pin the calling thread to one CPU.
+Returns false if that isn't supported on this platform or the operating system refuses.*/
+bool pinCurrentThread(int cpu);
+
+/**Set the calling thread's scheduling.
+Returns false if that isn't supported or the operating system refuses, in which case the thread is left as it was.*/
+bool setCurrentThreadScheduling(ThreadScheduling policy, int priority);
+
+}
@@ -10,8 +10,22 @@ See LICENSE in the root of the powercores repository for details.*/
 #include <future>
 #include <type_traits>
 #include <system_error>
+#include <exception>
+#include <algorithm>
+#include <memory>
+#include <functional>
 #include "exceptions.hpp"
+#include "barrier.hpp"
+#include "cancellation.hpp"
+#include "future.hpp"
 #include "threadsafe_queue.hpp"
+#include "job_queue.hpp"
+#include "pool_allocator.hpp"
+#include "task.hpp"
+#include "thread_placement.hpp"
+#include "thread_pool_stats.hpp"
+#include "timer_wheel.hpp"
+#include "wait_policy.hpp"
 #include "utilities.hpp"
 
 namespace powercores {
@@ -20,6 +34,80 @@ namespace powercores {
 class ThreadPoolPoisonException {
 };
 
+/**The kinds of queue a ThreadPool can keep its jobs in.  See ThreadPool::setJobQueueBackend.*/
+enum class JobQueueBackend {
+	/**A mutex-protected deque per worker (LockingJobQueue).  This is the default.*/
+	LOCKING,
+	/**A fixed-capacity lock-free ring buffer per worker (LockFreeJobQueue).*/
+	LOCK_FREE,
+};
+
+/**Where ThreadPool puts its workers; see ThreadPool::setWorkerAffinity.*/
+enum class WorkerAffinity {
+	/**Let the operating system move workers wherever it likes.*/
+	NONE,
+	/**Pin worker i to the i-th CPU of a list, wrapping around.*/
+	CPUS,
+	/**Pin workers in the order of CpuTopology::spreadOrder: one per package in turn, one per physical core before any hyperthreads.*/
+	SPREAD,
+};
+
+//Internal helpers for ThreadPool::parallelFor and ThreadPool::parallelReduce, do not use.
+//Every piece of the range subtracts its size from remaining when it finishes, and whichever piece brings it to 0 completes the promise and deletes the state.
+class ParallelStateBase: public PoolAllocated {
+	public:
+	ParallelStateBase(int count, int grainSize): remaining(count), grain(grainSize > 0 ? grainSize : 1) {}
+	void fail(std::exception_ptr e) {
+		if(failed.exchange(true) == false) error = e;
+	}
+	std::atomic<int> remaining;
+	int grain;
+	std::atomic<bool> failed{false};
+	std::exception_ptr error;
+	CancellationToken token;
+};
+
+template<typename CallableT>
+class ParallelForState: public ParallelStateBase {
+	public:
+	template<typename C>
+	ParallelForState(C &&c, int count, int grainSize): ParallelStateBase(count, grainSize), callable(std::forward<C>(c)) {}
+	void run(int begin, int end) {
+		for(; begin < end; begin++) callable(begin);
+	}
+	void complete() {
+		if(failed.load()) promise.set_exception(error);
+		else promise.set_value();
+		delete this;
+	}
+	CallableT callable;
+	std::promise<void> promise;
+};
+
+template<typename T, typename CallableT, typename CombineT>
+class ParallelReduceState: public ParallelStateBase {
+	public:
+	template<typename C, typename C2>
+	ParallelReduceState(T id, C &&c, C2 &&comb, int count, int grainSize): ParallelStateBase(count, grainSize), identity(id), result(id), callable(std::forward<C>(c)), combine(std::forward<C2>(comb)) {}
+	//Reduce locally, then take the lock once per piece rather than once per index.
+	void run(int begin, int end) {
+		T local = identity;
+		for(; begin < end; begin++) local = combine(local, callable(begin));
+		std::lock_guard<std::mutex> l(result_lock);
+		result = combine(result, local);
+	}
+	void complete() {
+		if(failed.load()) promise.set_exception(error);
+		else promise.set_value(result);
+		delete this;
+	}
+	T identity, result;
+	std::mutex result_lock;
+	CallableT callable;
+	CombineT combine;
+	std::promise<T> promise;
+};
+
 /**A pool of threads.  Accepts tasks in a fairly obvious manner.*/
 class ThreadPool {
 	public:
@@ -27,47 +115,219 @@ class ThreadPool {
 	~ThreadPool();
 	void start();
 	void stop() ;
+	/**Change the number of workers.
+	While the pool is running this happens live, without stopping anything: jobs already queued stay where they are, and barriers submitted afterwards wait for the new number of workers.
+	Growing wakes retired workers, or starts new ones.  Shrinking retires the highest numbered workers: they stop receiving jobs, finish the ones already in their queues, and then sleep until the pool grows again or stops, so they hold no cores.
+	Retired workers still wake briefly for barriers and submitJobToAllThreads, since they may have jobs from before they retired.
+	Growing past 64 workers, or past the auto-scaling maximum if that's larger, restarts the pool.
+	There is always at least one worker; n below 1 is treated as 1.*/
 	void setThreadCount(int n) ;
+	int getThreadCount();
+	/**Let the pool size itself between minThreads and maxThreads while it runs.
+	Every 10 ms, a background thread looks at the workers: if more jobs are waiting than there are workers and none is idle, it adds one, and if there has been an idle worker and nothing queued for all of quietPeriod, it retires one.
+	This stops and restarts the pool if it is running, which drops pending timers.*/
+	void setAutoScaling(int minThreads, int maxThreads, std::chrono::milliseconds quietPeriod = std::chrono::milliseconds(1000));
+	void disableAutoScaling();
+	bool getAutoScaling();
+	/**Turn work stealing on or off.  It is off by default.
+	When on, a worker whose queue is empty takes the oldest job from another worker's queue instead of going to sleep, which keeps every core busy when job costs are uneven.
+	Barriers and jobs submitted to all threads are never stolen, so the ordering guarantees of submitBarrier are unchanged.
+	This stops and restarts the pool if it is running, which drops pending timers.*/
+	void setWorkStealing(bool enabled);
+	bool getWorkStealing();
+	/**Choose the queue each worker keeps its jobs in.
+	LOCK_FREE avoids taking a mutex on every submission, which matters with many threads submitting at once.
+	Its queues hold at most capacity jobs each; submitting to a full queue waits for room, so capacity must cover any jobs which jobs themselves submit.
+	With work stealing on, the lock-free backend does not steal from a worker with a barrier pending.
+	This stops and restarts the pool if it is running, which drops pending timers.*/
+	void setJobQueueBackend(JobQueueBackend backend, unsigned int capacity = 4096);
+	JobQueueBackend getJobQueueBackend();
+	/**Pin workers to CPUs.  cpus is only used with WorkerAffinity::CPUS.
+	Each worker allocates its own queue after pinning itself, so the operating system's first-touch policy puts the queue's memory on the worker's NUMA node.  This covers all of a LOCK_FREE queue; a LOCKING queue allocates as jobs arrive.
+	Pinning is best effort: a worker which can't be pinned runs unpinned, and ThreadPoolStats::Worker::cpu says where each worker ended up.
+	This stops and restarts the pool if it is running, which drops pending timers.*/
+	void setWorkerAffinity(WorkerAffinity affinity, std::vector<int> cpus = std::vector<int>());
+	WorkerAffinity getWorkerAffinity();
+	/**Set the scheduling of every worker, for example ThreadScheduling::FIFO to run an audio pool at realtime priority.
+	This is also best effort, since it usually needs privileges; see ThreadPoolStats::Worker::scheduling_applied.
+	This stops and restarts the pool if it is running, which drops pending timers.*/
+	void setWorkerScheduling(ThreadScheduling policy, int priority = 0);
+	ThreadScheduling getWorkerScheduling();
+	/**Set how long an idle worker spins and yields before it sleeps.
+	A sleeping worker costs a futex wake-up when a job arrives, so spinning for a little longer than the usual gap between jobs keeps latency down at the price of some CPU time.
+	The default spins 1000 times and yields once.  WaitPolicy() sleeps straight away, which is better when there are fewer cores than workers.
+	This stops and restarts the pool if it is running, which drops pending timers.*/
+	void setWaitPolicy(WaitPolicy policy);
+	WaitPolicy getWaitPolicy();
+	/**Protect lower priority jobs from starvation.
+	Whenever a worker passes over a lane which has jobs limit times in favor of a higher one, its next jobs come from the starved lane.  The default is 16.
+	This stops and restarts the pool if it is running, which drops pending timers.*/
+	void setStarvationLimit(int limit);
+	int getStarvationLimit();
+	
+	/**Choose what happens to exceptions which escape jobs.
+	Jobs with a future, from submitJobWithResult, submitJobWithFuture, parallelFor and so on, already put their exceptions in it; this is for everything else.
+	The exception is counted in ThreadPoolStats::Worker::exceptions and passed to handler, on the thread which ran the job.  With no handler, which is the default, it is only counted.  Exceptions from the handler itself are dropped.
+	Either way, the worker carries on with its next job.
+	The handler can be changed at any time, without stopping the pool; jobs which finish afterwards use the new one.*/
+	void setExceptionHandler(std::function<void(std::exception_ptr)> handler);
+	
+	/**Get a snapshot of every worker's statistics: jobs run, time busy and idle, wake-ups, queue depth, and a histogram of the time from submission to the start of each job.
+	Collection is cheap enough to leave on in production: every counter is a relaxed atomic in storage owned by one worker.
+	Statistics start over whenever the pool starts.*/
+	ThreadPoolStats getStats();
+	void resetStats();
+	/**Statistics are on by default.  Turning them off saves reading the clock around every job.*/
+	void setStatsEnabled(bool enabled);
+	bool getStatsEnabled();
 	
 	/**Submit a job, which will be called in the future.
-	This is a template so that we can sometimes avoid copying internally.*/
+	The job is moved into a Task, so move-only callables work and small ones are never copied or allocated.
+	Any number of threads may submit at once.  Each submitting thread deals jobs out to the workers in turn, using a counter of its own, so submitters share nothing but the queues.
+	With work stealing on, jobs submitted by a worker go into its own queue instead, where the data they touch is likely still in cache; idle workers steal them if it stays busy.*/
 	template<typename CallableT>
 	void submitJob(CallableT&& job) {
-		auto &job_queue = job_queues[job_queue_pointer];
-		job_queue->enqueue(job);
-		job_queue_pointer = (job_queue_pointer+1)%thread_count;
+		submitJob(JobPriority::NORMAL, std::forward<CallableT>(job));
+	}
+
+	/**Submit a job at a priority.
+	Workers drain HIGH jobs before NORMAL ones and NORMAL before LOW: HIGH is for latency-critical work such as rendering the next block, and LOW for background work such as loading data.
+	Barriers only order NORMAL jobs.  HIGH and LOW jobs may start on either side of any barrier.*/
+	template<typename CallableT>
+	void submitJob(JobPriority priority, CallableT&& job) {
+		enqueueJob(pickWorker(), Task(std::forward<CallableT>(job)), false, priority);
+	}
+
+	/**Submit a job which is skipped if token is cancelled before it starts.  While it runs, CancellationToken::current returns token.*/
+	template<typename CallableT>
+	void submitJob(const CancellationToken &token, CallableT&& job) {
+		submitJob(JobPriority::NORMAL, token, std::forward<CallableT>(job));
+	}
+
+	template<typename CallableT>
+	void submitJob(JobPriority priority, const CancellationToken &token, CallableT&& job) {
+		submitJob(priority, [token, job = typename std::decay<CallableT>::type(std::forward<CallableT>(job))] () mutable {
+			if(token.isCancelled()) return;
+			CancellationScope scope(token);
+			job();
+		});
+	}
+
+	/**Submit a job to run once delay has passed.
+	Timers are kept on a timer wheel with a resolution of TimerWheel::TICK (1 ms), driven by one thread which the pool starts the first time it is needed.  A timer therefore fires up to a tick late, and then waits in the queue like any other job.
+	Any number of timers may be pending.  Submitting one is lock-free, and cancelling one through the TimerHandle is a single atomic operation.
+	Only submit timers while the pool is running.  Timers which haven't fired when the pool stops are dropped.*/
+	template<typename CallableT>
+	TimerHandle submitJobAfter(std::chrono::steady_clock::duration delay, CallableT &&job, JobPriority priority = JobPriority::NORMAL) {
+		return submitJobAt(std::chrono::steady_clock::now()+delay, std::forward<CallableT>(job), priority);
+	}
+
+	/**Submit a job to run at a time.  Times in the past run as soon as possible.*/
+	template<typename CallableT>
+	TimerHandle submitJobAt(std::chrono::steady_clock::time_point when, CallableT &&job, JobPriority priority = JobPriority::NORMAL) {
+		auto node = new TimerNode(Task(std::forward<CallableT>(job)), priority, 0);
+		getTimerWheel().add(node, when);
+		return TimerHandle(node);
+	}
+
+	/**Submit a job to run every period, starting one period from now, until cancelled through the TimerHandle.
+	The schedule doesn't drift, since each run is due a whole number of periods after the first.  A run never overlaps the previous one: if the job is still running when the next run comes due, that run is skipped.*/
+	template<typename CallableT>
+	TimerHandle submitPeriodicJob(std::chrono::steady_clock::duration period, CallableT &&job, JobPriority priority = JobPriority::NORMAL) {
+		auto ticks = std::max<long long>(1, std::chrono::duration_cast<std::chrono::nanoseconds>(period).count()/std::chrono::duration_cast<std::chrono::nanoseconds>(TimerWheel::TICK).count());
+		auto node = new TimerNode(Task(std::forward<CallableT>(job)), priority, ticks);
+		getTimerWheel().add(node, std::chrono::steady_clock::now()+period);
+		return TimerHandle(node);
 	}
 
 	/**Submit a job, possibly with arguments, to all threads.*/
 	template<typename CallableT, typename... ArgsT>
 	void submitJobToAllThreads(CallableT &&callable, ArgsT&&... args) {
 		//This is a GCC workaround. MSVC and Clang can capture callable as-is.
-		auto job = [callable = callable, args...]() mutable {
+		auto job = [callable = std::forward<CallableT>(callable), args...]() mutable {
 			callable(args...);
 		};
-		for(auto &i: job_queues) i->enqueue(job);
+		//Every thread needs its own copy, including retired workers.
+		std::lock_guard<std::mutex> l(resize_lock);
+		int live = live_workers.load();
+		for(int i = 0; i < live; i++) enqueueJob(i, Task(job), true);
 	}
 	
 	/**Submit a job represented by a function with arguments and a return value, obtaining a future which will later contain the result of the job.*/
 	template<class FuncT, class... ArgsT>
 	std::future<typename std::result_of<FuncT(ArgsT...)>::type> submitJobWithResult(FuncT &&callable, ArgsT&&... args) {
-		//The task is not copyable, so we keep a pointer and delete it after we execute it.
-		auto task = new std::packaged_task<typename std::result_of<FuncT(ArgsT...)>::type(ArgsT...)>(callable);
-		auto job = [task, args...] () mutable {
-			(*task)(args...);
-			delete task;
-		};
-		auto retval = task->get_future();
-		submitJob(job);
+		//Task can hold move-only callables, so the packaged_task lives inside the job.
+		std::packaged_task<typename std::result_of<FuncT(ArgsT...)>::type(ArgsT...)> task(std::forward<FuncT>(callable));
+		auto retval = task.get_future();
+		submitJob([task = std::move(task), args...] () mutable {
+			task(args...);
+		});
+		return retval;
+	}
+
+	/**Like submitJobWithResult, but at a priority.*/
+	template<class FuncT, class... ArgsT>
+	std::future<typename std::result_of<FuncT(ArgsT...)>::type> submitJobWithResult(JobPriority priority, FuncT &&callable, ArgsT&&... args) {
+		std::packaged_task<typename std::result_of<FuncT(ArgsT...)>::type(ArgsT...)> task(std::forward<FuncT>(callable));
+		auto retval = task.get_future();
+		submitJob(priority, [task = std::move(task), args...] () mutable {
+			task(args...);
+		});
 		return retval;
 	}
 	
+	/**Like submitJobWithResult, but returns a powercores::Future, which can take continuations with then and be combined with whenAll and whenAny.
+	There is no packaged_task, and the Future's state is recycled, so this usually allocates nothing.*/
+	template<class FuncT, class... ArgsT>
+	Future<typename std::result_of<FuncT(ArgsT...)>::type> submitJobWithFuture(FuncT &&callable, ArgsT&&... args) {
+		return submitJobWithFuture(JobPriority::NORMAL, std::forward<FuncT>(callable), std::forward<ArgsT>(args)...);
+	}
+
+	template<class FuncT, class... ArgsT>
+	Future<typename std::result_of<FuncT(ArgsT...)>::type> submitJobWithFuture(JobPriority priority, FuncT &&callable, ArgsT&&... args) {
+		typedef typename std::result_of<FuncT(ArgsT...)>::type ResultT;
+		Promise<ResultT> promise;
+		auto retval = promise.getFuture();
+		submitJob(priority, [promise = std::move(promise), callable = typename std::decay<FuncT>::type(std::forward<FuncT>(callable)), args...] () mutable {
+			FutureFulfil<ResultT>::run(promise, [&] () {return callable(args...);});
+		});
+		return retval;
+	}
+
+	/**Like submitJobWithFuture, but the job is skipped if token is cancelled before it starts, and the Future then holds a JobCancelledException.*/
+	template<class FuncT, class... ArgsT>
+	Future<typename std::result_of<FuncT(ArgsT...)>::type> submitJobWithFuture(const CancellationToken &token, FuncT &&callable, ArgsT&&... args) {
+		return submitJobWithFuture(JobPriority::NORMAL, token, std::forward<FuncT>(callable), std::forward<ArgsT>(args)...);
+	}
+
+	template<class FuncT, class... ArgsT>
+	Future<typename std::result_of<FuncT(ArgsT...)>::type> submitJobWithFuture(JobPriority priority, const CancellationToken &token, FuncT &&callable, ArgsT&&... args) {
+		typedef typename std::result_of<FuncT(ArgsT...)>::type ResultT;
+		Promise<ResultT> promise;
+		auto retval = promise.getFuture();
+		submitJob(priority, [token, promise = std::move(promise), callable = typename std::decay<FuncT>::type(std::forward<FuncT>(callable)), args...] () mutable {
+			if(token.isCancelled()) {
+				promise.setException(std::make_exception_ptr(JobCancelledException()));
+				return;
+			}
+			CancellationScope scope(token);
+			FutureFulfil<ResultT>::run(promise, [&] () {return callable(args...);});
+		});
+		return retval;
+	}
+
 	/**Submit a range of jobs which will be started in order as threads become available from begin to end.*/
 	template<class IterT>
 	void submitJobRange(IterT begin, IterT end) {
 		for(; begin != end; begin++) submitJob(*begin);
 	}
 
+	/**submitJobRange, with every job skipped if token is cancelled before it starts.*/
+	template<class IterT>
+	void submitJobRange(const CancellationToken &token, IterT begin, IterT end) {
+		for(; begin != end; begin++) submitJob(token, *begin);
+	}
+
 	/**Submit a range of jobs.
 	The jobs will run in some unspecified order.  This is faster than submitJobRange.
 	
@@ -76,46 +336,241 @@ class ThreadPool {
 	void submitJobRangeUnordered(IterT begin, IterT end) {
 		int size = end-begin;
 		if(size == 0) return;
-		int perThread = size/thread_count;
-		//We're giving some to all threads, we don't need to update the job_queue_pointer.
-		//If we did, it'd just be what it was when we started.
-		for(int i = 0; i < thread_count; i++) {
-			job_queues[(job_queue_pointer+i)%thread_count]->enqueueRange(begin, begin+perThread);
+		int count = thread_count.load(std::memory_order_acquire);
+		int perThread = size/count;
+		int first = pickWorker();
+		long long submitted = submitTimestamp();
+		for(int i = 0; i < count; i++) {
+			int worker = (first+i)%count;
+			worker_stats[worker]->noteQueueDepth(job_queues[worker]->enqueueRange(begin, begin+perThread, submitted));
 			begin+=perThread;
 		}
+		if(work_stealing) wakeIdleWorkers(true);
 		//Submit the rest normally.
 		submitJobRange(begin, end);
 	}
 	
 	/**Map a function over a range specified by two iterators.
-	The function receives the result of dereferencing the iterator and any additional arguments, and will run in some unspecified order.  The iterators must be random access.*/
+	The function receives the result of dereferencing the iterator and any additional arguments, and will run in some unspecified order.  The iterators must be random access.
+	Returns a future which becomes ready once the function has been called on every item.*/
 	template<typename CallableT, typename IterT, typename... ArgsT>
-	void map(CallableT &&callable, IterT begin, IterT end, ArgsT&&... args) {
-		auto executor = [callable = callable, args...](IterT subrangeBegin, IterT subrangeEnd) {
-			for(; subrangeBegin != subrangeEnd; subrangeBegin++) callable(*subrangeBegin, args...);
-		};
-		int amount = end-begin;
-		int amountPerThread = amount/thread_count;
-		for(int i = 0; i < thread_count; i++) {
-			submitJobWithResult(executor, begin, begin+amountPerThread);
-			begin += amountPerThread;
-		}
-		if(begin != end) submitJobWithResult(executor, begin, end);
+	std::future<void> map(CallableT &&callable, IterT begin, IterT end, ArgsT&&... args) {
+		return parallelFor(0, end-begin, [callable = std::forward<CallableT>(callable), begin, args...] (int i) mutable {
+			callable(*(begin+i), args...);
+		});
+	}
+	
+	/**Call callable(i) for every i from begin to end, not including end, in some unspecified order.
+	Returns a future which becomes ready once every call has finished.  If any call throws, the future holds the first exception, and indices which had not yet started are skipped.
+	
+	The range is split adaptively.  Each worker starts with an equal piece, and works through it grainSize indices at a time; whenever another worker is idle, a running piece splits off half of what it has left as a new job.
+	Choose grainSize so that one grain is a few microseconds of work.*/
+	template<typename CallableT>
+	std::future<void> parallelFor(int begin, int end, CallableT &&callable, int grainSize = 1) {
+		return parallelFor(CancellationToken(), begin, end, std::forward<CallableT>(callable), grainSize);
+	}
+	
+	/**parallelFor, checking token before every grain.  Once it is cancelled, indices which haven't started are skipped and the future holds a JobCancelledException.
+	Calls can check CancellationToken::current to stop early.*/
+	template<typename CallableT>
+	std::future<void> parallelFor(const CancellationToken &token, int begin, int end, CallableT &&callable, int grainSize = 1) {
+		auto state = new ParallelForState<typename std::decay<CallableT>::type>(std::forward<CallableT>(callable), end > begin ? end-begin : 0, grainSize);
+		state->token = token;
+		auto retval = state->promise.get_future();
+		startParallel(state, begin, end);
+		return retval;
+	}
+	
+	/**Reduce over every i from begin to end, not including end.
+	The result is identity combined with callable(i) for every i, using combine(T, T).  combine must be associative and commutative, since the order in which pieces are combined is unspecified.
+	Splitting, grainSize and exceptions work as for parallelFor.*/
+	template<typename T, typename CallableT, typename CombineT>
+	std::future<T> parallelReduce(int begin, int end, T identity, CallableT &&callable, CombineT &&combine, int grainSize = 1) {
+		auto state = new ParallelReduceState<T, typename std::decay<CallableT>::type, typename std::decay<CombineT>::type>(identity, std::forward<CallableT>(callable), std::forward<CombineT>(combine), end > begin ? end-begin : 0, grainSize);
+		auto retval = state->promise.get_future();
+		startParallel(state, begin, end);
+		return retval;
 	}
 	
 	/**Submit a barrier.	
-	A barrier ensures that all jobs enqueued before the barrier will finish execution before any job after the barrier begins execution.*/
+	A barrier ensures that all jobs enqueued before the barrier will finish execution before any job after the barrier begins execution.
+	This allocates nothing: every worker arrives at the pool's reusable Barrier, which is only replaced when new workers start.*/
 	void submitBarrier() ;
 	
+	/**Wait for handle, which is a std::future, std::shared_future or powercores::Future, running the pool's jobs on this thread until it is ready.
+	The calling core does useful work instead of sleeping, and a job can wait for jobs it submitted without deadlocking the pool: if no worker has started them, the waiter runs them itself.
+	That includes jobs a worker has taken from its queue in the same batch as the waiting job but not yet started.
+	Workers of this pool take jobs the way work stealing takes them, so pinned jobs and anything queued behind them are left alone.  A job therefore must not wait for jobs submitted after a barrier which it is ahead of.
+	Any other thread only takes jobs from queues with no barrier or other pinned job pending, and a worker whose job it took waits for that job to finish before running its next pinned job, so barriers still order everything submitted before them.
+	When there is nothing to run, the caller spins and yields according to the wait policy, then sleeps for short intervals which grow from 10 to 1000 microseconds.*/
+	template<typename HandleT>
+	void waitFor(HandleT &&handle) {
+		std::chrono::microseconds backoff(10);
+		while(handleReady(handle) == false) {
+			if(runPendingJob()) {
+				backoff = std::chrono::microseconds(10);
+				continue;
+			}
+			if(wait_policy.wait([&] () {return handleReady(handle) || hasPendingJob();})) continue;
+			sleepOnHandle(handle, backoff);
+			backoff = std::min(backoff*2, std::chrono::microseconds(1000));
+		}
+	}
+	
+	/**Submit a barrier, then wait as waitFor does until every job submitted before it has finished.
+	Only call this from outside the pool, since a worker can't wait for a barrier which it must itself arrive at.*/
+	void waitForBarrier();
+	
 	private:
 	
+	template<typename T>
+	static bool handleReady(std::future<T> &f) {
+		return f.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	}
+	template<typename T>
+	static bool handleReady(std::shared_future<T> &f) {
+		return f.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	}
+	template<typename T>
+	static bool handleReady(Future<T> &f) {
+		return f.isReady();
+	}
+	template<typename T>
+	static void sleepOnHandle(std::future<T> &f, std::chrono::microseconds t) {
+		f.wait_for(t);
+	}
+	template<typename T>
+	static void sleepOnHandle(std::shared_future<T> &f, std::chrono::microseconds t) {
+		f.wait_for(t);
+	}
+	//Future has no timed wait, because it would need a continuation which outlives the wait.
+	template<typename T>
+	static void sleepOnHandle(Future<T> &, std::chrono::microseconds t) {
+		std::this_thread::sleep_for(t);
+	}
+	//Run a job, sending any exception other than poison to the exception handler.
+	void runJob(Task &job, WorkerStats* stats);
+	//Take one job which a thief could take, and run it on this thread.  Returns false if there wasn't one.
+	bool runPendingJob();
+	bool hasPendingJob();
+	
+	template<typename StateT>
+	void startParallel(StateT* state, int begin, int end) {
+		if(begin >= end) {
+			state->complete();
+			return;
+		}
+		int pieces = std::max(1, std::min(thread_count.load(std::memory_order_relaxed), (end-begin)/state->grain));
+		for(int i = 0; i < pieces; i++) {
+			int pieceBegin = begin+(int)((long long)(end-begin)*i/pieces);
+			int pieceEnd = begin+(int)((long long)(end-begin)*(i+1)/pieces);
+			submitJob([this, state, pieceBegin, pieceEnd] () {runParallelPiece(state, pieceBegin, pieceEnd);});
+		}
+	}
+	
+	template<typename StateT>
+	void runParallelPiece(StateT* state, int begin, int end) {
+		int mine = end-begin;
+		CancellationScope scope(state->token);
+		while(begin < end) {
+			if(state->failed.load(std::memory_order_relaxed)) break;
+			if(state->token.isCancelled()) {
+				state->fail(std::make_exception_ptr(JobCancelledException()));
+				break;
+			}
+			if(end-begin >= 2*state->grain && idle_workers.load(std::memory_order_relaxed)) {
+				int middle = begin+(end-begin)/2;
+				mine -= end-middle;
+				submitJob([this, state, middle, end] () {runParallelPiece(state, middle, end);});
+				end = middle;
+			}
+			int stop = std::min(end, begin+state->grain);
+			try {
+				state->run(begin, stop);
+			}
+			catch(...) {
+				state->fail(std::current_exception());
+			}
+			begin = stop;
+		}
+		if(state->remaining.fetch_sub(mine) == mine) state->complete();
+	}
+	
+	//Start or wake workers until there are n, or retire workers until there are n.
+	void resize(int n);
+	//For settings which workers only read when they start: stop the pool if it is running, call change, and start it again.
+	template<typename CallableT>
+	void restartAround(CallableT &&change) {
+		bool wasRunning = running.load() == 1;
+		if(wasRunning) stop();
+		change();
+		if(wasRunning) start();
+	}
+	void autoScalerThreadFunction();
+	//Starts the timer wheel the first time it's needed.
+	TimerWheel& getTimerWheel();
+	//Called by the timer wheel's thread when a timer comes due.
+	void fireTimer(TimerNode* node);
+	//The worker an unpinned submission from this thread should go to.
+	int pickWorker();
+	//Every submission ends up here.
+	void enqueueJob(int worker, Task job, bool pinned = false, JobPriority priority = JobPriority::NORMAL);
+	long long submitTimestamp();
+	//Places the worker, allocates what it owns, and then runs one of the following.
+	void workerMain(int id, int cpu);
 	void workerThreadFunction(int id);
+	void workStealingThreadFunction(int id);
+	bool stealJob(int id, JobQueue::Entry &output);
+	//Sleep until something is submitted, unless there is already work for this worker.
+	void parkIdleWorker(int id);
+	//Wake one idle worker, or all of them if the new work is pinned to a specific worker.
+	void wakeIdleWorkers(bool all);
 	
-	//job_queue_pointer is the queue we're writing into.
-	int thread_count = 0, job_queue_pointer = 0;
+	//thread_count is how many workers get jobs.  Workers from thread_count to live_workers are retired, and max_workers is how many the vectors have room for.
+	//resize publishes new workers' queues and stats by storing live_workers, so load it with at least acquire before indexing them.
+	std::atomic<int> thread_count{0}, live_workers{0};
+	int max_workers = 0;
 	std::vector<std::thread> threads;
-	std::vector<ThreadsafeQueue<std::function<void(void)>>*> job_queues;
+	std::vector<JobQueue*> job_queues;
+	std::vector<WorkerStats*> worker_stats;
+	std::atomic<bool> stats_enabled{true};
 	std::atomic<int> running;
+	std::atomic<TimerWheel*> timer_wheel{nullptr};
+	std::mutex timer_wheel_lock;
+	//Shared by every submitBarrier.  Workers pass barriers in the order they were submitted, so one is enough until new workers start.
+	std::shared_ptr<Barrier> barrier;
+	//Held while the set of workers changes, and by anything which must reach every worker.
+	std::mutex resize_lock;
+	bool auto_scaling = false;
+	int auto_scaling_min = 1, auto_scaling_max = 1;
+	std::chrono::milliseconds auto_scaling_quiet_period{1000};
+	std::thread scaler_thread;
+	std::mutex scaler_lock;
+	std::condition_variable scaler_notify;
+	bool scaler_stopping = false;
+	bool work_stealing = false;
+	JobQueueBackend job_queue_backend = JobQueueBackend::LOCKING;
+	unsigned int job_queue_capacity = 4096;
+	WorkerAffinity worker_affinity = WorkerAffinity::NONE;
+	std::vector<int> worker_cpus, placement_cpus;
+	ThreadScheduling worker_scheduling = ThreadScheduling::DEFAULT;
+	int worker_priority = 0;
+	//New workers report here once they have created their queues.
+	std::mutex start_lock;
+	std::condition_variable start_notify;
+	int started_workers = 0;
+	//Workers with nothing to do.  parallelFor splits work when this is nonzero.
+	std::atomic<int> idle_workers{0};
+	//Of which asleep on idle_notify, rather than spinning.
+	std::atomic<int> parked_workers{0};
+	WaitPolicy wait_policy{1000, 1};
+	//Read and replaced with std::atomic_load and std::atomic_store.
+	std::shared_ptr<const std::function<void(std::exception_ptr)>> exception_handler;
+	int starvation_limit = 16;
+	//Idle workers in work stealing mode sleep here rather than on their own queues, so that any submission can wake them.
+	std::mutex idle_lock;
+	std::condition_variable idle_notify;
+	unsigned long long idle_version = 0;
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,68 @@
+/**This file is part of powercores, released under the terms of the Unlicense.
+See LICENSE in the root of the powercores repository for details.*/
+#pragma once
+#include <atomic>
+#include <vector>
+#include "utilities.hpp"
+
+namespace powercores {
+
+/**A snapshot of a ThreadPool's statistics, from ThreadPool::getStats.*/
+class ThreadPoolStats {
+	public:
+	/**Bucket i of the latency histogram counts jobs which waited at least 2^i and less than 2^(i+1) nanoseconds (bucket 0 also counts 0).*/
+	static const int LATENCY_BUCKETS = 40;
+
+	class Worker {
+		public:
+		unsigned long long jobs_executed = 0;
+		/**Time spent running jobs, and time spent waiting for them, in nanoseconds.*/
+		unsigned long long busy_ns = 0, idle_ns = 0;
+		/**How many times the worker ran out of work and waited for more, whether by spinning or sleeping.*/
+		unsigned long long wakeups = 0;
+		/**Exceptions which escaped jobs run by this worker; see ThreadPool::setExceptionHandler.*/
+		unsigned long long exceptions = 0;
+		/**Jobs waiting in this worker's queue when the snapshot was taken, and the most there have ever been.*/
+		unsigned int queue_depth = 0, max_queue_depth = 0;
+		/**The CPU the worker is pinned to, or -1 if it isn't, including if pinning failed.*/
+		int cpu = -1;
+		/**False if the pool was asked to change the worker's scheduling and the operating system refused.*/
+		bool scheduling_applied = true;
+	};
+
+	std::vector<Worker> workers;
+	/**Time from submission to the start of execution, over all workers.*/
+	unsigned long long latency_histogram[LATENCY_BUCKETS] = {0};
+
+	/**Sum jobs_executed over all workers.*/
+	unsigned long long getJobsExecuted();
+
+	/**An upper bound in nanoseconds on the submit-to-start latency of fraction p of jobs, where p is between 0 and 1.
+	This is the top of the histogram bucket containing that percentile, so it is accurate to within a factor of 2.  Returns 0 if no jobs have run.*/
+	unsigned long long latencyPercentile(double p);
+};
+
+/**Internal to ThreadPool, do not use.
+One worker's counters.  Everything is relaxed atomics, and the fields written by different threads are on different cache lines.*/
+class WorkerStats {
+	public:
+	WorkerStats();
+	void recordLatency(long long ns);
+	void noteQueueDepth(unsigned int depth);
+	void reset();
+	void snapshot(ThreadPoolStats::Worker &worker, unsigned long long* histogram);
+
+	char pad0[CACHE_LINE_SIZE];
+	//Written by the worker.
+	std::atomic<unsigned long long> jobs_executed{0}, busy_ns{0}, idle_ns{0}, wakeups{0}, exceptions{0};
+	std::atomic<unsigned long long> latency_histogram[ThreadPoolStats::LATENCY_BUCKETS];
+	char pad1[CACHE_LINE_SIZE];
+	//Written by submitters.
+	std::atomic<unsigned int> max_queue_depth{0};
+	char pad2[CACHE_LINE_SIZE];
+	//Set by the worker before the pool finishes starting, and never changed.
+	int cpu = -1;
+	bool scheduling_applied = true;
+};
+
+}
@@ -7,11 +7,16 @@ See LICENSE in the root of the powercores repository for details.*/
 #include <chrono>
 #include <queue>
 #include <atomic>
+#include <utility>
 #include "exceptions.hpp"
+#include "wait_policy.hpp"
 
 namespace powercores {
 /**A threadsafe queue supporting any number of readers and writers.
 
+Readers which find the queue empty wait according to a WaitPolicy, which by default sleeps straight away.
+Writers only make the wake-up call if a reader is actually asleep.
+
 Note: T must be default constructible, copy assignable and copy constructible.*/
 template <typename T>
 class ThreadsafeQueue {
@@ -19,20 +24,17 @@ class ThreadsafeQueue {
 	/**Enqueue an item.*/
 	void enqueue(T item) {
 		std::unique_lock<std::mutex> l(lock);
-		internal_queue.push_front(item);
-		_size++;
-		enqueued_notify.notify_one();
+		internal_queue.push_front(std::move(item));
+		_size.store(_size.load(std::memory_order_relaxed)+1, std::memory_order_relaxed);
+		if(sleepers) enqueued_notify.notify_one();
 	}
 
 	/**Dequeue an item.
 If there is no item in the queue, this function sleeps forever.*/
 	T dequeue() {
+		spin();
 		std::unique_lock<std::mutex> l(lock);
-		if(internal_queue.empty() == false) {
-			return actualDequeue();
-		}
-
-		enqueued_notify.wait(l, [this]() {return internal_queue.empty() == false;});
+		sleepUntilNotEmpty(l);
 		return actualDequeue();
 	}
 
@@ -42,7 +44,9 @@ If there is no item in the queue, this function sleeps forever.*/
 		if(internal_queue.empty() == false) {
 			return actualDequeue();
 		}
+		sleepers++;
 		bool res = enqueued_notify.wait_for(l, std::chrono::milliseconds(timeoutInMS), [this]() {return internal_queue.empty() == false;});
+		sleepers--;
 		if(res) return actualDequeue();
 		else throw TimeoutException();
 	}
@@ -52,15 +56,18 @@ If there is no item in the queue, this function sleeps forever.*/
 	void enqueueRange(IterT begin, IterT end) {
 		std::unique_lock<std::mutex> l(lock);
 		for(; begin != end; begin++) internal_queue.push_front(*begin);
+		_size.store(internal_queue.size(), std::memory_order_relaxed);
+		if(sleepers) enqueued_notify.notify_all();
 	}
 	
 	/**DequeueRange dequeues at least one item and at most the specified count, storing them in the iterator.
 	The number of items dequeued is returned.*/
 	template<class IterT>
 	int dequeueRange(int count, IterT output) {
+		spin();
 		std::unique_lock<std::mutex> l(lock);
 		int ret = 0;
-		if(internal_queue.empty()) enqueued_notify.wait(l, [this] () {return internal_queue.empty() == false;});
+		sleepUntilNotEmpty(l);
 		while(ret < count && internal_queue.empty() == false) {
 			*output = actualDequeue();
 			ret++;
@@ -77,21 +84,46 @@ If there is no item in the queue, this function sleeps forever.*/
 /**Get the current number of items in the queue.*/
 	unsigned int size() {
 		std::lock_guard<std::mutex> l(lock);
-		return _size;
+		return _size.load(std::memory_order_relaxed);
+	}
+
+	/**Set how readers wait when the queue is empty.  Only call this when nobody is waiting.*/
+	void setWaitPolicy(WaitPolicy policy) {
+		wait_policy = policy;
+	}
+
+	WaitPolicy getWaitPolicy() {
+		return wait_policy;
 	}
 	
 	private:
 	T actualDequeue() {
-		auto res = internal_queue.back();
+		auto res = std::move(internal_queue.back());
 		internal_queue.pop_back();
-		_size--;
+		_size.store(_size.load(std::memory_order_relaxed)-1, std::memory_order_relaxed);
 		return res;
 	}
+
+	//Spin without the lock, so that we don't get in the writer's way.
+	void spin() {
+		wait_policy.wait([this] () {return _size.load(std::memory_order_relaxed) != 0;});
+	}
+
+	void sleepUntilNotEmpty(std::unique_lock<std::mutex> &l) {
+		if(internal_queue.empty() == false) return;
+		sleepers++;
+		enqueued_notify.wait(l, [this] () {return internal_queue.empty() == false;});
+		sleepers--;
+	}
 	
 	std::mutex lock;
 	std::deque<T> internal_queue;
 	std::condition_variable enqueued_notify;
-	unsigned int _size = 0;
+	//Only written with the lock held, but readers spin on it without.
+	std::atomic<unsigned int> _size{0};
+	//Readers asleep on enqueued_notify.
+	int sleepers = 0;
+	WaitPolicy wait_policy;
 };
 
 }
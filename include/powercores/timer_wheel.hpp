@@ -0,0 +1,125 @@
+/**This file is part of powercores, released under the terms of the Unlicense.
+See LICENSE in the root of the powercores repository for details.*/
+#pragma once
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <functional>
+#include "task.hpp"
+#include "job_queue.hpp"
+#include "pool_allocator.hpp"
+
+namespace powercores {
+
+//Internal to TimerWheel, do not use.
+//Owned by the TimerHandle, the wheel, and any job running it, so it lives until all three are done with it.
+class TimerNode: public PoolAllocated {
+	public:
+	enum {PENDING, FIRED, CANCELLED};
+	TimerNode(Task j, JobPriority p, unsigned long long periodTicks): job(std::move(j)), priority(p), period(periodTicks) {}
+	void release() {
+		if(references.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this;
+	}
+	Task job;
+	JobPriority priority;
+	//In ticks.  period is 0 for one-shot timers.
+	unsigned long long expires = 0, period;
+	std::atomic<int> state{PENDING};
+	std::atomic<int> references{2};
+	//Periodic jobs never overlap themselves.
+	std::atomic<bool> running{false};
+	//Links the node into the inbox, and then into a slot of the wheel.
+	TimerNode* next = nullptr;
+};
+
+/**A pending timer from ThreadPool::submitJobAfter, submitJobAt or submitPeriodicJob.
+Dropping the handle doesn't cancel the timer.*/
+class TimerHandle {
+	public:
+	TimerHandle() {}
+	explicit TimerHandle(TimerNode* n): node(n) {}
+	TimerHandle(TimerHandle &&other) noexcept: node(other.node) {
+		other.node = nullptr;
+	}
+	TimerHandle& operator=(TimerHandle &&other) noexcept {
+		if(this != &other) {
+			if(node) node->release();
+			node = other.node;
+			other.node = nullptr;
+		}
+		return *this;
+	}
+	TimerHandle(const TimerHandle&) = delete;
+	TimerHandle& operator=(const TimerHandle&) = delete;
+	~TimerHandle() {
+		if(node) node->release();
+	}
+
+	/**Stop the timer.  Returns true if it was pending, in which case a one-shot job will never run and a periodic job will run no more, apart from a run which has already started.*/
+	bool cancel() {
+		if(node == nullptr) return false;
+		int expected = TimerNode::PENDING;
+		return node->state.compare_exchange_strong(expected, TimerNode::CANCELLED);
+	}
+
+	/**True until a one-shot timer fires, or until the timer is cancelled.*/
+	bool isPending() {
+		return node != nullptr && node->state.load() == TimerNode::PENDING;
+	}
+
+	private:
+	TimerNode* node = nullptr;
+};
+
+/**Internal to ThreadPool, do not use.
+
+A hierarchical timer wheel: four levels of 256 slots, with a tick of TICK.
+Level 0 holds timers due within 256 ticks, one slot per tick; each higher level covers 256 times as much with slots as long as the whole level below, and a slot is moved down a level when the level below wraps around.
+Adding, firing and cancelling are all O(1) however many timers there are.  Cancelled timers are left in place, and dropped when their slot comes up.
+
+The wheel belongs to its thread.  Other threads add timers by pushing them onto a lock-free inbox, and only take a lock to wake the thread when their timer is due before it planned to wake up.
+Between timers the thread sleeps until the next occupied slot of level 0, or until level 0 wraps around, so it doesn't wake every tick.*/
+class TimerWheel {
+	public:
+	typedef std::chrono::steady_clock Clock;
+	static const std::chrono::milliseconds TICK;
+
+	/**fire is called on the wheel's thread for every timer which comes due and hasn't been cancelled.*/
+	TimerWheel(std::function<void(TimerNode*)> fire);
+	/**Stops the thread.  Timers which haven't fired are dropped.*/
+	~TimerWheel();
+
+	/**Takes over the wheel's reference to node.*/
+	void add(TimerNode* node, Clock::time_point when);
+
+	private:
+	static const int LEVELS = 4, SLOTS = 256, SLOT_BITS = 8;
+	void threadFunction();
+	void drainInbox();
+	void insert(TimerNode* node);
+	//Move on one tick, firing whatever is due.
+	void advance();
+	void expire(TimerNode* node);
+	//When to wake up next, as a tick, or 0 if the wheel is empty.
+	unsigned long long nextWakeTick();
+	unsigned long long tickOf(Clock::time_point t, bool roundUp);
+	Clock::time_point timeOf(unsigned long long tick);
+
+	std::function<void(TimerNode*)> fire;
+	Clock::time_point epoch;
+	//Owned by the wheel's thread.
+	TimerNode* slots[LEVELS][SLOTS];
+	unsigned long long current_tick = 0;
+	int timer_count = 0;
+	std::atomic<TimerNode*> inbox{nullptr};
+	//In nanoseconds since epoch.  Adders compare against this to see if they need to wake the thread.
+	std::atomic<long long> next_wake{0};
+	std::mutex lock;
+	std::condition_variable wake;
+	bool stopping = false;
+	std::thread thread;
+};
+
+}
@@ -5,9 +5,28 @@ See LICENSE in the root of the powercores repository for details.*/
 #include <system_error>
 #include <utility>
 #include <functional>
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <intrin.h>
+#endif
 
 namespace powercores {
 
+/**The size of a cache line, for padding things which different threads write so that they don't share one.
+64 is right for every x86 and most ARM processors we care about.*/
+const int CACHE_LINE_SIZE = 64;
+
+/**Tell the processor we're in a spin loop.
+This is the pause instruction on x86, which saves power and gets out of the other hyperthread's way.*/
+inline void cpuRelax() {
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+	_mm_pause();
+#elif defined(__i386__) || defined(__x86_64__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+	asm volatile("yield");
+#endif
+}
+
 /**If using threads directly, it is required that one deal with EAGAIN.
 This function wraps the std::thread constructor and automatically retries.
 If any other error besides EAGAIN (std::errc::resource_unavailable_try_again) occurs, the exception is rethrown.
@@ -0,0 +1,36 @@
+/**This file is part of powercores, released under the terms of the Unlicense.
+See LICENSE in the root of the powercores repository for details.*/
+#pragma once
+#include <thread>
+#include "utilities.hpp"
+
+namespace powercores {
+
+/**How a thread waits for something which is probably about to happen.
+
+Sleeping on a condition variable costs a futex wake-up, tens of microseconds, when the wait ends.
+A WaitPolicy first spins spin_count times with cpuRelax, then yields yield_count times, and only then lets the caller sleep.
+The default never spins, which is right when waits are long or cores are scarce.*/
+class WaitPolicy {
+	public:
+	WaitPolicy(int spinCount = 0, int yieldCount = 0): spin_count(spinCount), yield_count(yieldCount) {}
+
+	/**Spin and then yield until ready returns true.
+	Returns false if the budget ran out first, in which case the caller should sleep.*/
+	template<typename PredicateT>
+	bool wait(PredicateT &&ready) const {
+		for(int i = 0; i < spin_count; i++) {
+			if(ready()) return true;
+			cpuRelax();
+		}
+		for(int i = 0; i < yield_count; i++) {
+			if(ready()) return true;
+			std::this_thread::yield();
+		}
+		return ready();
+	}
+
+	int spin_count, yield_count;
+};
+
+}
@@ -0,0 +1,341 @@
+/**This file is part of powercores, released under the terms of the Unlicense.
+See LICENSE in the root of the powercores repository for details.*/
+
+/*Benchmarks for every powercores primitive.
+
+Usage: powercores_bench [--quick] [name...]
+With names, only benchmarks whose names start with one of them run.
+
+Output is CSV on stdout, one line per benchmark and configuration, so runs can be diffed or loaded into anything:
+benchmark,threads,producers,consumers,operations,seconds,ops_per_second,p50_ns,p90_ns,p99_ns,max_ns
+Latency columns are empty for benchmarks which only measure throughput.*/
+
+#include <powercores/threadsafe_queue.hpp>
+#include <powercores/lock_free_queue.hpp>
+#include <powercores/spsc_ring_buffer.hpp>
+#include <powercores/thread_pool.hpp>
+#include <powercores/barrier.hpp>
+#include <powercores/thread_local_variable.hpp>
+#include <powercores/combinable_variable.hpp>
+#include <powercores/pool_allocator.hpp>
+#include <powercores/utilities.hpp>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <functional>
+#include <stdio.h>
+#include <string.h>
+
+typedef std::chrono::steady_clock Clock;
+
+long long nowNs() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+bool quick = false;
+std::vector<std::string> filters;
+
+bool wanted(const char* name) {
+	if(filters.empty()) return true;
+	for(auto &f: filters) if(strncmp(name, f.c_str(), f.size()) == 0) return true;
+	return false;
+}
+
+//Scale an operation count down for --quick.
+int ops(int n) {
+	return quick ? std::max(1, n/20) : n;
+}
+
+std::vector<int> threadCounts() {
+	int max = std::max(4, (int)std::thread::hardware_concurrency());
+	std::vector<int> ret;
+	for(int i = 1; i <= max && i <= 16; i *= 2) ret.push_back(i);
+	return ret;
+}
+
+//Sorts latencies.  Pass an empty vector for throughput-only benchmarks.
+void report(const char* name, int threads, int producers, int consumers, long long operations, double seconds, std::vector<long long> &latencies) {
+	printf("%s,%i,%i,%i,%lli,%.6f,%.1f,", name, threads, producers, consumers, operations, seconds, operations/seconds);
+	if(latencies.empty()) printf(",,,\n");
+	else {
+		std::sort(latencies.begin(), latencies.end());
+		auto percentile = [&] (double p) {return latencies[std::min(latencies.size()-1, (size_t)(p*latencies.size()))];};
+		printf("%lli,%lli,%lli,%lli\n", percentile(0.5), percentile(0.9), percentile(0.99), latencies.back());
+	}
+	fflush(stdout);
+}
+
+//Items carry the time they were enqueued, so consumers can measure latency.
+//Every producer sends perProducer items; consumers stop when they've all arrived.
+template<typename EnqueueT, typename DequeueT>
+void queueBenchmark(const char* name, int producers, int consumers, int perProducer, EnqueueT enqueue, DequeueT dequeue) {
+	std::atomic<int> consumed{0};
+	int total = producers*perProducer;
+	std::vector<std::vector<long long>> latencies(consumers);
+	std::vector<std::thread> threads;
+	auto start = Clock::now();
+	for(int c = 0; c < consumers; c++) {
+		threads.push_back(powercores::safeStartThread([&, c] () {
+			long long item;
+			while(consumed.load(std::memory_order_relaxed) < total) {
+				if(dequeue(item) == false) {
+					std::this_thread::yield();
+					continue;
+				}
+				//-1 is a wake-up item, sent so that blocking consumers can notice we're done.
+				if(item < 0) continue;
+				if(consumed.fetch_add(1, std::memory_order_relaxed)%16 == 0) latencies[c].push_back(nowNs()-item);
+			}
+		}));
+	}
+	for(int p = 0; p < producers; p++) {
+		threads.push_back(powercores::safeStartThread([&] () {
+			for(int i = 0; i < perProducer; i++) {
+				while(enqueue(nowNs()) == false) std::this_thread::yield();
+			}
+		}));
+	}
+	for(int p = 0; p < producers; p++) threads[consumers+p].join();
+	while(consumed.load() < total) std::this_thread::yield();
+	for(int c = 0; c < consumers; c++) while(enqueue(-1) == false) std::this_thread::yield();
+	for(int c = 0; c < consumers; c++) threads[c].join();
+	double seconds = std::chrono::duration<double>(Clock::now()-start).count();
+	std::vector<long long> all;
+	for(auto &l: latencies) all.insert(all.end(), l.begin(), l.end());
+	report(name, producers+consumers, producers, consumers, total, seconds, all);
+}
+
+const int ratios[][2] = {{1, 1}, {2, 2}, {4, 1}, {1, 4}, {4, 4}};
+
+void benchmarkQueues() {
+	if(wanted("queue_threadsafe")) {
+		for(auto &r: ratios) {
+			powercores::ThreadsafeQueue<long long> q;
+			queueBenchmark("queue_threadsafe", r[0], r[1], ops(400000)/r[0], [&] (long long i) {q.enqueue(i); return true;}, [&] (long long &out) {out = q.dequeue(); return true;});
+		}
+	}
+	if(wanted("queue_lock_free")) {
+		for(auto &r: ratios) {
+			powercores::LockFreeQueue<long long> q(4096);
+			queueBenchmark("queue_lock_free", r[0], r[1], ops(400000)/r[0], [&] (long long i) {return q.tryEnqueue(i);}, [&] (long long &out) {return q.tryDequeue(out);});
+		}
+	}
+	if(wanted("queue_spsc_ring_buffer")) {
+		powercores::SpscRingBuffer<long long> rb(4096);
+		queueBenchmark("queue_spsc_ring_buffer", 1, 1, ops(2000000), [&] (long long i) {return rb.tryWrite(i);}, [&] (long long &out) {return rb.tryRead(out);});
+	}
+	if(wanted("spsc_ring_buffer_blocks")) {
+		//Whole blocks of samples, as the audio thread moves them.
+		powercores::SpscRingBuffer<float> rb(8192);
+		int blocks = ops(200000), blockSize = 256;
+		auto start = Clock::now();
+		std::thread writer([&] () {
+			std::vector<float> block(blockSize, 1.0f);
+			for(int b = 0; b < blocks; b++) {
+				unsigned int done = 0;
+				while(done < block.size()) {
+					unsigned int got = rb.write(block.data()+done, block.size()-done);
+					if(got == 0) std::this_thread::yield();
+					done += got;
+				}
+			}
+		});
+		std::vector<float> block(blockSize);
+		for(int b = 0; b < blocks; b++) {
+			unsigned int done = 0;
+			while(done < block.size()) {
+				unsigned int got = rb.read(block.data()+done, block.size()-done);
+				if(got == 0) std::this_thread::yield();
+				done += got;
+			}
+		}
+		writer.join();
+		std::vector<long long> none;
+		report("spsc_ring_buffer_blocks", 2, 1, 1, (long long)blocks*blockSize, std::chrono::duration<double>(Clock::now()-start).count(), none);
+	}
+}
+
+void benchmarkPool() {
+	for(int threads: threadCounts()) {
+		for(int stealing = 0; stealing < 2; stealing++) {
+			const char* name = stealing ? "pool_submit_to_run_stealing" : "pool_submit_to_run";
+			if(wanted(name) == false) continue;
+			powercores::ThreadPool tp{threads};
+			tp.setWorkStealing(stealing == 1);
+			tp.start();
+			int jobs = ops(200000);
+			std::vector<long long> latencies(jobs);
+			auto start = Clock::now();
+			for(int i = 0; i < jobs; i++) {
+				long long submitted = nowNs();
+				tp.submitJob([&latencies, i, submitted] () {latencies[i] = nowNs()-submitted;});
+			}
+			tp.stop();
+			report(name, threads, 1, threads, jobs, std::chrono::duration<double>(Clock::now()-start).count(), latencies);
+		}
+		if(wanted("pool_submit_job_with_result")) {
+			//Round trips: submit, then wait for the result before submitting again.
+			powercores::ThreadPool tp{threads};
+			tp.start();
+			int jobs = ops(50000);
+			std::vector<long long> latencies(jobs);
+			auto start = Clock::now();
+			for(int i = 0; i < jobs; i++) {
+				long long submitted = nowNs();
+				tp.submitJobWithResult([] (int x) {return x;}, i).get();
+				latencies[i] = nowNs()-submitted;
+			}
+			report("pool_submit_job_with_result", threads, 1, threads, jobs, std::chrono::duration<double>(Clock::now()-start).count(), latencies);
+			tp.stop();
+		}
+		if(wanted("pool_submit_job_with_future")) {
+			//The same round trips with powercores::Future.
+			powercores::ThreadPool tp{threads};
+			tp.start();
+			int jobs = ops(50000);
+			std::vector<long long> latencies(jobs);
+			auto start = Clock::now();
+			for(int i = 0; i < jobs; i++) {
+				long long submitted = nowNs();
+				tp.submitJobWithFuture([] (int x) {return x;}, i).get();
+				latencies[i] = nowNs()-submitted;
+			}
+			report("pool_submit_job_with_future", threads, 1, threads, jobs, std::chrono::duration<double>(Clock::now()-start).count(), latencies);
+			tp.stop();
+		}
+		if(wanted("pool_barrier_round_trip")) {
+			//A barrier plus one job after it, waited on.
+			powercores::ThreadPool tp{threads};
+			tp.start();
+			int rounds = ops(20000);
+			std::vector<long long> latencies(rounds);
+			auto start = Clock::now();
+			for(int i = 0; i < rounds; i++) {
+				long long submitted = nowNs();
+				tp.submitBarrier();
+				tp.submitJobWithResult([] () {}).get();
+				latencies[i] = nowNs()-submitted;
+			}
+			report("pool_barrier_round_trip", threads, 1, threads, rounds, std::chrono::duration<double>(Clock::now()-start).count(), latencies);
+			tp.stop();
+		}
+	}
+}
+
+void benchmarkBarrier() {
+	if(wanted("barrier_round_trip") == false) return;
+	for(int threads: threadCounts()) {
+		if(threads < 2) continue;
+		powercores::Barrier barrier(threads);
+		int rounds = ops(50000);
+		std::vector<long long> latencies(rounds);
+		std::vector<std::thread> thread_array;
+		auto start = Clock::now();
+		for(int t = 1; t < threads; t++) {
+			thread_array.push_back(powercores::safeStartThread([&] () {
+				for(int r = 0; r < rounds; r++) barrier.arriveAndWait();
+			}));
+		}
+		for(int r = 0; r < rounds; r++) {
+			long long before = nowNs();
+			barrier.arriveAndWait();
+			latencies[r] = nowNs()-before;
+		}
+		for(auto &i: thread_array) i.join();
+		report("barrier_round_trip", threads, 0, 0, rounds, std::chrono::duration<double>(Clock::now()-start).count(), latencies);
+	}
+}
+
+void benchmarkThreadLocalVariable() {
+	for(int threads: threadCounts()) {
+		if(wanted("combinable_variable_accumulate")) {
+			//Accumulate per thread and combine at the end, against everyone hitting one atomic.
+			powercores::CombinableVariable<long long> v;
+			int accesses = ops(10000000);
+			std::vector<std::thread> thread_array;
+			auto start = Clock::now();
+			for(int t = 0; t < threads; t++) {
+				thread_array.push_back(powercores::safeStartThread([&] () {
+					long long &local = *v;
+					for(int i = 0; i < accesses; i++) local += i;
+				}));
+			}
+			for(auto &i: thread_array) i.join();
+			v.combine([] (long long a, long long b) {return a+b;});
+			std::vector<long long> none;
+			report("combinable_variable_accumulate", threads, 0, 0, (long long)accesses*threads, std::chrono::duration<double>(Clock::now()-start).count(), none);
+		}
+		if(wanted("atomic_accumulate")) {
+			std::atomic<long long> v{0};
+			int accesses = ops(10000000);
+			std::vector<std::thread> thread_array;
+			auto start = Clock::now();
+			for(int t = 0; t < threads; t++) {
+				thread_array.push_back(powercores::safeStartThread([&] () {
+					for(int i = 0; i < accesses; i++) v.fetch_add(i, std::memory_order_relaxed);
+				}));
+			}
+			for(auto &i: thread_array) i.join();
+			std::vector<long long> none;
+			report("atomic_accumulate", threads, 0, 0, (long long)accesses*threads, std::chrono::duration<double>(Clock::now()-start).count(), none);
+		}
+	}
+	if(wanted("thread_local_variable_access") == false) return;
+	for(int threads: threadCounts()) {
+		powercores::ThreadLocalVariable<long long> v;
+		int accesses = ops(10000000);
+		std::vector<std::thread> thread_array;
+		auto start = Clock::now();
+		for(int t = 0; t < threads; t++) {
+			thread_array.push_back(powercores::safeStartThread([&] () {
+				for(int i = 0; i < accesses; i++) *v += i;
+			}));
+		}
+		for(auto &i: thread_array) i.join();
+		std::vector<long long> none;
+		report("thread_local_variable_access", threads, 0, 0, (long long)accesses*threads, std::chrono::duration<double>(Clock::now()-start).count(), none);
+	}
+}
+
+void benchmarkAllocator() {
+	//One thread allocates and another frees, as with job closures.
+	for(int pooled = 0; pooled < 2; pooled++) {
+		const char* name = pooled ? "allocator_pool_cross_thread" : "allocator_new_cross_thread";
+		if(wanted(name) == false) continue;
+		powercores::SpscRingBuffer<void*> rb(4096);
+		int blocks = ops(2000000);
+		auto start = Clock::now();
+		std::thread freer([&] () {
+			void* b;
+			for(int i = 0; i < blocks; i++) {
+				while(rb.tryRead(b) == false) std::this_thread::yield();
+				if(pooled) powercores::poolFree(b);
+				else ::operator delete(b);
+			}
+		});
+		for(int i = 0; i < blocks; i++) {
+			void* b = pooled ? powercores::poolAllocate(96) : ::operator new(96);
+			while(rb.tryWrite(b) == false) std::this_thread::yield();
+		}
+		freer.join();
+		std::vector<long long> none;
+		report(name, 2, 1, 1, blocks, std::chrono::duration<double>(Clock::now()-start).count(), none);
+	}
+}
+
+int main(int argc, char** args) {
+	for(int i = 1; i < argc; i++) {
+		if(strcmp(args[i], "--quick") == 0) quick = true;
+		else filters.push_back(args[i]);
+	}
+	printf("benchmark,threads,producers,consumers,operations,seconds,ops_per_second,p50_ns,p90_ns,p99_ns,max_ns\n");
+	benchmarkQueues();
+	benchmarkPool();
+	benchmarkBarrier();
+	benchmarkThreadLocalVariable();
+	benchmarkAllocator();
+	return 0;
+}
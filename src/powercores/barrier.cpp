@@ -0,0 +1,68 @@
+#include <powercores/barrier.hpp>
+#include <powercores/utilities.hpp>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <climits>
+#endif
+
+namespace powercores {
+
+Barrier::Barrier(int count, int spinCount): count(count), spin_count(spinCount), remaining(count) {
+}
+
+void Barrier::arriveAndWait() {
+	int myPhase = phase.load(std::memory_order_acquire);
+	if(remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		//We're last.  Reset for the next round before anyone can see the new phase.
+		remaining.store(count, std::memory_order_relaxed);
+		phase.store(myPhase+1, std::memory_order_release);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if(sleepers.load(std::memory_order_relaxed)) wakeAll();
+		return;
+	}
+	for(int i = 0; i < spin_count; i++) {
+		if(phase.load(std::memory_order_acquire) != myPhase) return;
+		cpuRelax();
+	}
+	while(phase.load(std::memory_order_acquire) == myPhase) sleep(myPhase);
+}
+
+int Barrier::getCount() {
+	return count;
+}
+
+#ifdef __linux__
+
+void Barrier::sleep(int expectedPhase) {
+	sleepers.fetch_add(1);
+	//The kernel checks the phase again before sleeping, so a wake between our check and here isn't lost.
+	syscall(SYS_futex, reinterpret_cast<int*>(&phase), FUTEX_WAIT_PRIVATE, expectedPhase, nullptr, nullptr, 0);
+	sleepers.fetch_sub(1);
+}
+
+void Barrier::wakeAll() {
+	syscall(SYS_futex, reinterpret_cast<int*>(&phase), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+}
+
+#else
+
+void Barrier::sleep(int expectedPhase) {
+	std::unique_lock<std::mutex> l(lock);
+	sleepers.fetch_add(1);
+	phase_changed.wait(l, [&] () {return phase.load() != expectedPhase;});
+	sleepers.fetch_sub(1);
+}
+
+void Barrier::wakeAll() {
+	std::lock_guard<std::mutex> l(lock);
+	phase_changed.notify_all();
+}
+
+#endif
+
+}
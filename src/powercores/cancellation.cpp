@@ -0,0 +1,20 @@
+#include <powercores/cancellation.hpp>
+
+namespace powercores {
+
+//Not a reference: the scope which set it holds a token, which keeps it alive.
+static thread_local CancellationState* current_cancellation = nullptr;
+
+CancellationToken CancellationToken::current() {
+	return CancellationToken(current_cancellation);
+}
+
+CancellationScope::CancellationScope(const CancellationToken &token): previous(current_cancellation) {
+	current_cancellation = token.state;
+}
+
+CancellationScope::~CancellationScope() {
+	current_cancellation = previous;
+}
+
+}
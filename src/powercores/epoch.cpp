@@ -0,0 +1,167 @@
+#include <powercores/epoch.hpp>
+#include <powercores/utilities.hpp>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <utility>
+
+namespace powercores {
+
+/*Every thread which uses epochs gets a record, on a list which is only ever pushed to, so that advancing the epoch can walk it without a lock.
+A record's epoch is 0 outside critical sections, and otherwise the global epoch as it was when the thread entered.
+Records of exited threads are reused, like the pool allocator's caches.*/
+
+//Retire this many before trying to collect.
+static const unsigned int COLLECT_THRESHOLD = 64;
+
+class RetiredNode {
+	public:
+	void* p;
+	void (*deleter)(void*);
+	unsigned long long epoch;
+};
+
+class EpochRecord {
+	public:
+	std::atomic<unsigned long long> epoch{0};
+	//Everything below is only touched by the owning thread.
+	int nesting = 0;
+	std::vector<RetiredNode> retired;
+	EpochRecord* next = nullptr;
+	EpochRecord* next_free = nullptr;
+};
+
+static std::atomic<unsigned long long> global_epoch{1};
+static std::atomic<EpochRecord*> records{nullptr};
+
+static std::mutex registry_lock;
+static EpochRecord* free_records = nullptr;
+//Lists of exited threads, waiting for someone to collect them.
+static std::vector<RetiredNode> orphans;
+static std::atomic<bool> have_orphans{false};
+
+static thread_local EpochRecord* thread_record = nullptr;
+static thread_local bool thread_record_dead = false;
+
+static void releaseThreadRecord() {
+	auto r = thread_record;
+	thread_record = nullptr;
+	thread_record_dead = true;
+	r->nesting = 0;
+	r->epoch.store(0, std::memory_order_release);
+	std::lock_guard<std::mutex> l(registry_lock);
+	orphans.insert(orphans.end(), r->retired.begin(), r->retired.end());
+	r->retired.clear();
+	r->retired.shrink_to_fit();
+	if(orphans.empty() == false) have_orphans.store(true, std::memory_order_release);
+	r->next_free = free_records;
+	free_records = r;
+}
+
+static EpochRecord* getThreadRecord() {
+	if(thread_record || thread_record_dead) return thread_record;
+	std::lock_guard<std::mutex> l(registry_lock);
+	if(free_records) {
+		thread_record = free_records;
+		free_records = free_records->next_free;
+	}
+	else {
+		thread_record = new EpochRecord();
+		thread_record->next = records.load(std::memory_order_relaxed);
+		records.store(thread_record, std::memory_order_release);
+	}
+	atThreadExit(releaseThreadRecord);
+	return thread_record;
+}
+
+void epochEnter() {
+	auto r = getThreadRecord();
+	if(r == nullptr || r->nesting++ > 0) return;
+	//Announce an epoch, and make sure it was still current once the announcement could be seen.  Otherwise the epoch could move on twice without waiting for us.
+	auto e = global_epoch.load();
+	while(true) {
+		r->epoch.store(e);
+		auto now = global_epoch.load();
+		if(now == e) break;
+		e = now;
+	}
+}
+
+void epochLeave() {
+	auto r = thread_record;
+	if(r == nullptr || --r->nesting > 0) return;
+	r->epoch.store(0, std::memory_order_release);
+}
+
+static void tryAdvance() {
+	auto g = global_epoch.load();
+	for(auto r = records.load(std::memory_order_acquire); r; r = r->next) {
+		auto e = r->epoch.load();
+		if(e != 0 && e != g) return;
+	}
+	global_epoch.compare_exchange_strong(g, g+1);
+}
+
+//Free whatever is old enough.  Returns true if anything is left.
+static bool freeRetired(EpochRecord* r) {
+	auto g = global_epoch.load();
+	std::vector<RetiredNode> dead;
+	unsigned int kept = 0;
+	for(auto &i: r->retired) {
+		if(i.epoch+2 <= g) dead.push_back(i);
+		else r->retired[kept++] = i;
+	}
+	r->retired.resize(kept);
+	//Deleters may retire more, so run them once the list is consistent again.
+	for(auto &i: dead) i.deleter(i.p);
+	return r->retired.empty() == false;
+}
+
+static void adoptOrphans(EpochRecord* r) {
+	if(have_orphans.load(std::memory_order_acquire) == false) return;
+	std::lock_guard<std::mutex> l(registry_lock);
+	r->retired.insert(r->retired.end(), orphans.begin(), orphans.end());
+	orphans.clear();
+	have_orphans.store(false, std::memory_order_relaxed);
+}
+
+void epochRetire(void* p, void (*deleter)(void*)) {
+	auto r = getThreadRecord();
+	//Unlinked before now, so any reader who found it announced this epoch or an earlier one.
+	RetiredNode node{p, deleter, global_epoch.load()};
+	if(r == nullptr) {
+		//This thread is exiting.
+		std::lock_guard<std::mutex> l(registry_lock);
+		orphans.push_back(node);
+		have_orphans.store(true, std::memory_order_release);
+		return;
+	}
+	r->retired.push_back(node);
+	if(r->retired.size() >= COLLECT_THRESHOLD) {
+		tryAdvance();
+		freeRetired(r);
+	}
+}
+
+void epochCollect() {
+	auto r = getThreadRecord();
+	if(r == nullptr) return;
+	adoptOrphans(r);
+	//Nodes from the current epoch need it to move twice.
+	for(int i = 0; i < 2; i++) {
+		tryAdvance();
+		if(freeRetired(r) == false) return;
+	}
+}
+
+void epochQuiescentPoint() {
+	auto r = thread_record;
+	//Threads which never used epochs pay one thread_local load per job.
+	if(r == nullptr) return;
+	adoptOrphans(r);
+	if(r->retired.empty()) return;
+	tryAdvance();
+	freeRetired(r);
+}
+
+}
@@ -0,0 +1,222 @@
+#include <powercores/pool_allocator.hpp>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <cstddef>
+#include <algorithm>
+
+namespace powercores {
+
+/*Every block starts with a header saying which thread's pool it belongs to and its size class.
+Free blocks keep their header, and use the space after it as a link.
+
+A thread freeing blocks which belong to another thread's pool gathers them, per size class, while they keep going to the same owner, and hands them over with one CAS per batch rather than one per block.
+
+A pool is never deleted.  When its thread exits it goes on the orphan list, and the next new thread takes it over, along with any blocks still out.
+That way a block can always be returned to its owner, however late it is freed.*/
+
+static const int SIZE_CLASSES = 8;
+static const std::size_t MIN_SIZE = 16;
+//Each freelist holds at most this many bytes of blocks, and at least MIN_CACHED blocks.
+//Blocks usually come back in bursts as large as a queue of jobs, so a list needs room for thousands of small blocks: 4096 of the size most job closures use, which is also the lock-free job queue's default capacity.
+static const std::size_t MAX_CACHED_BYTES = 512*1024;
+static const int MIN_CACHED = 64;
+static const int OUTGOING_BATCH = 32;
+
+class PoolCache;
+
+class alignas(std::max_align_t) BlockHeader {
+	public:
+	//nullptr for large blocks, which bypass the pools.
+	PoolCache* owner;
+	int size_class;
+};
+
+class FreeBlock {
+	public:
+	FreeBlock* next;
+};
+
+class PoolCache {
+	public:
+	PoolCache() {
+		for(int i = 0; i < SIZE_CLASSES; i++) {
+			remote[i].store(nullptr);
+			remote_count[i].store(0);
+		}
+	}
+	//Only touched by the owning thread.
+	FreeBlock* local[SIZE_CLASSES] = {nullptr};
+	int local_count[SIZE_CLASSES] = {0};
+	//Blocks freed by other threads.  Anyone pushes, and the owner takes the whole list at once, so there is no ABA problem.
+	std::atomic<FreeBlock*> remote[SIZE_CLASSES];
+	std::atomic<int> remote_count[SIZE_CLASSES];
+	//Blocks this thread has freed for one other pool, not yet handed over.  Only touched by the owning thread.
+	PoolCache* outgoing_owner[SIZE_CLASSES] = {nullptr};
+	FreeBlock* outgoing_head[SIZE_CLASSES] = {nullptr};
+	FreeBlock* outgoing_tail[SIZE_CLASSES] = {nullptr};
+	int outgoing_count[SIZE_CLASSES] = {0};
+	PoolCache* next_orphan = nullptr;
+};
+
+static std::mutex orphan_lock;
+static PoolCache* orphans = nullptr;
+
+//Both trivially destructible, so they stay usable while other thread_local destructors run.
+static thread_local PoolCache* thread_cache = nullptr;
+static thread_local bool thread_cache_dead = false;
+
+static int maxCached(int c) {
+	return std::max(MIN_CACHED, (int)(MAX_CACHED_BYTES/(MIN_SIZE << c)));
+}
+
+static void releaseList(FreeBlock* b) {
+	while(b) {
+		auto next = b->next;
+		::operator delete(reinterpret_cast<BlockHeader*>(b)-1);
+		b = next;
+	}
+}
+
+//Push the chain head to tail, of count blocks, onto owner's remote list.
+static void pushRemote(PoolCache* owner, int c, FreeBlock* head, FreeBlock* tail, int count) {
+	//The count is approximate, which is fine: it only bounds how much memory waits on the list.
+	if(owner->remote_count[c].fetch_add(count, std::memory_order_relaxed) >= maxCached(c)) {
+		owner->remote_count[c].fetch_sub(count, std::memory_order_relaxed);
+		releaseList(head);
+		return;
+	}
+	auto old = owner->remote[c].load(std::memory_order_relaxed);
+	do {
+		tail->next = old;
+	} while(owner->remote[c].compare_exchange_weak(old, head, std::memory_order_release, std::memory_order_relaxed) == false);
+}
+
+static void flushOutgoing(PoolCache* cache, int c) {
+	auto head = cache->outgoing_head[c];
+	if(head) pushRemote(cache->outgoing_owner[c], c, head, cache->outgoing_tail[c], cache->outgoing_count[c]);
+	cache->outgoing_owner[c] = nullptr;
+	cache->outgoing_head[c] = nullptr;
+	cache->outgoing_tail[c] = nullptr;
+	cache->outgoing_count[c] = 0;
+}
+
+class PoolCacheHolder {
+	public:
+	~PoolCacheHolder() {
+		auto cache = thread_cache;
+		for(int i = 0; i < SIZE_CLASSES; i++) flushOutgoing(cache, i);
+		thread_cache_dead = true;
+		thread_cache = nullptr;
+		for(int i = 0; i < SIZE_CLASSES; i++) {
+			releaseList(cache->local[i]);
+			cache->local[i] = nullptr;
+			cache->local_count[i] = 0;
+			cache->remote_count[i].store(0);
+			releaseList(cache->remote[i].exchange(nullptr, std::memory_order_acquire));
+		}
+		std::lock_guard<std::mutex> l(orphan_lock);
+		cache->next_orphan = orphans;
+		orphans = cache;
+	}
+};
+
+static PoolCache* getThreadCache() {
+	if(thread_cache || thread_cache_dead) return thread_cache;
+	{
+		std::lock_guard<std::mutex> l(orphan_lock);
+		if(orphans) {
+			thread_cache = orphans;
+			orphans = orphans->next_orphan;
+		}
+	}
+	if(thread_cache == nullptr) thread_cache = new PoolCache();
+	//Constructed on first use, so it is destroyed before thread_local objects which were created earlier, such as ThreadLocalVariable values.  Those are why getThreadCache copes with thread_cache_dead.
+	static thread_local PoolCacheHolder holder;
+	return thread_cache;
+}
+
+static int sizeClassOf(std::size_t size) {
+	int c = 0;
+	while((MIN_SIZE << c) < size) c++;
+	return c;
+}
+
+void* poolAllocate(std::size_t size) {
+	if(size > POOL_ALLOCATOR_MAX_SIZE) {
+		auto header = static_cast<BlockHeader*>(::operator new(sizeof(BlockHeader)+size));
+		header->owner = nullptr;
+		header->size_class = -1;
+		return header+1;
+	}
+	int c = sizeClassOf(size);
+	auto cache = getThreadCache();
+	if(cache == nullptr) {
+		//This thread is exiting.
+		auto header = static_cast<BlockHeader*>(::operator new(sizeof(BlockHeader)+(MIN_SIZE << c)));
+		header->owner = nullptr;
+		header->size_class = -1;
+		return header+1;
+	}
+	if(cache->local[c] == nullptr && cache->remote[c].load(std::memory_order_relaxed)) {
+		cache->remote_count[c].store(0, std::memory_order_relaxed);
+		auto list = cache->remote[c].exchange(nullptr, std::memory_order_acquire);
+		int count = 0;
+		for(auto b = list; b; b = b->next) count++;
+		cache->local[c] = list;
+		cache->local_count[c] = count;
+	}
+	auto block = cache->local[c];
+	if(block) {
+		cache->local[c] = block->next;
+		cache->local_count[c]--;
+		return block;
+	}
+	auto header = static_cast<BlockHeader*>(::operator new(sizeof(BlockHeader)+(MIN_SIZE << c)));
+	header->owner = cache;
+	header->size_class = c;
+	return header+1;
+}
+
+void poolFree(void* p) {
+	if(p == nullptr) return;
+	auto header = static_cast<BlockHeader*>(p)-1;
+	auto owner = header->owner;
+	if(owner == nullptr) {
+		::operator delete(header);
+		return;
+	}
+	int c = header->size_class;
+	auto block = static_cast<FreeBlock*>(p);
+	if(owner == thread_cache) {
+		if(owner->local_count[c] >= maxCached(c)) {
+			::operator delete(header);
+			return;
+		}
+		block->next = owner->local[c];
+		owner->local[c] = block;
+		owner->local_count[c]++;
+		return;
+	}
+	auto cache = getThreadCache();
+	if(cache == nullptr) {
+		//This thread is exiting.
+		pushRemote(owner, c, block, block, 1);
+		return;
+	}
+	//This thread's first pool may be the owner's, taken over from the orphan list.
+	if(cache == owner) {
+		poolFree(p);
+		return;
+	}
+	if(cache->outgoing_owner[c] != owner) {
+		flushOutgoing(cache, c);
+		cache->outgoing_owner[c] = owner;
+		cache->outgoing_tail[c] = block;
+	}
+	block->next = cache->outgoing_head[c];
+	cache->outgoing_head[c] = block;
+	if(++cache->outgoing_count[c] >= OUTGOING_BATCH) flushOutgoing(cache, c);
+}
+
+}
@@ -0,0 +1,81 @@
+#include <powercores/strand.hpp>
+#include <powercores/thread_pool.hpp>
+#include <powercores/utilities.hpp>
+#include <atomic>
+#include <thread>
+
+namespace powercores {
+
+static const int STRAND_BATCH = 32;
+
+Strand::Strand(ThreadPool &pool, JobPriority priority): pool(pool), priority(priority), head(&stub), tail(&stub) {
+}
+
+Strand::~Strand() {
+	while(pending.load() != 0) std::this_thread::yield();
+}
+
+bool Strand::empty() {
+	return pending.load() == 0;
+}
+
+void Strand::enqueue(StrandNode* node) {
+	push(node);
+	if(pending.fetch_add(1, std::memory_order_acq_rel) == 0) schedule();
+}
+
+void Strand::push(StrandNode* node) {
+	node->next.store(nullptr, std::memory_order_relaxed);
+	auto prev = head.exchange(node, std::memory_order_acq_rel);
+	prev->next.store(node, std::memory_order_release);
+}
+
+StrandNode* Strand::pop() {
+	auto t = tail;
+	auto next = t->next.load(std::memory_order_acquire);
+	if(t == &stub) {
+		if(next == nullptr) return nullptr;
+		tail = next;
+		t = next;
+		next = next->next.load(std::memory_order_acquire);
+	}
+	if(next) {
+		tail = next;
+		return t;
+	}
+	//t is the last node.  Unless a push is underway, put the stub behind it so that t can be taken.
+	if(t != head.load(std::memory_order_acquire)) return nullptr;
+	push(&stub);
+	next = t->next.load(std::memory_order_acquire);
+	if(next) {
+		tail = next;
+		return t;
+	}
+	return nullptr;
+}
+
+void Strand::schedule() {
+	pool.submitJob(priority, [this] () {run();});
+}
+
+void Strand::run() {
+	for(int ran = 0; ran < STRAND_BATCH; ran++) {
+		StrandNode* node;
+		//pending says a job is coming, so at worst its producer is between the two halves of push.
+		while((node = pop()) == nullptr) cpuRelax();
+		Task job = std::move(node->job);
+		delete node;
+		try {
+			job();
+		}
+		catch(...) {
+			if(pending.fetch_sub(1, std::memory_order_acq_rel) != 1) schedule();
+			throw;
+		}
+		if(pending.fetch_sub(1, std::memory_order_acq_rel) == 1) return;
+	}
+	//Still busy: go to the back of the pool's queue.
+	schedule();
+}
+
+}
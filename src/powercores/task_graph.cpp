@@ -0,0 +1,108 @@
+#include <powercores/task_graph.hpp>
+#include <powercores/thread_pool.hpp>
+#include <powercores/exceptions.hpp>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <stdexcept>
+#include <vector>
+
+namespace powercores {
+
+void TaskGraph::addEdge(int from, int to) {
+	if(from < 0 || from >= (int)nodes.size() || to < 0 || to >= (int)nodes.size()) throw std::out_of_range("TaskGraph node id out of range");
+	edges.emplace_back(from, to);
+	compiled = false;
+}
+
+void TaskGraph::compile() {
+	int count = (int)nodes.size();
+	successor_offsets.assign(count+1, 0);
+	predecessor_counts.assign(count, 0);
+	for(auto &e: edges) {
+		successor_offsets[e.first+1]++;
+		predecessor_counts[e.second]++;
+	}
+	for(int i = 0; i < count; i++) successor_offsets[i+1] += successor_offsets[i];
+	successors.resize(edges.size());
+	std::vector<int> fill(successor_offsets.begin(), successor_offsets.end()-1);
+	for(auto &e: edges) successors[fill[e.first]++] = e.second;
+	roots.clear();
+	for(int i = 0; i < count; i++) if(predecessor_counts[i] == 0) roots.push_back(i);
+	//Kahn's algorithm: if we can't visit every node by removing roots, there's a cycle.
+	std::vector<int> counts(predecessor_counts), ready(roots);
+	int visited = 0;
+	while(ready.empty() == false) {
+		int n = ready.back();
+		ready.pop_back();
+		visited++;
+		for(int i = successor_offsets[n]; i < successor_offsets[n+1]; i++) {
+			if(--counts[successors[i]] == 0) ready.push_back(successors[i]);
+		}
+	}
+	if(visited != count) throw CycleException();
+	pending.reset(new std::atomic<int>[count]);
+	compiled = true;
+}
+
+void TaskGraph::run(ThreadPool &pool) {
+	start(pool);
+	wait();
+}
+
+void TaskGraph::start(ThreadPool &pool) {
+	if(compiled == false) compile();
+	int count = (int)nodes.size();
+	if(count == 0) return;
+	for(int i = 0; i < count; i++) pending[i].store(predecessor_counts[i], std::memory_order_relaxed);
+	failed.store(false, std::memory_order_relaxed);
+	error = nullptr;
+	this->pool = &pool;
+	{
+		std::lock_guard<std::mutex> l(done_lock);
+		done = false;
+	}
+	remaining.store(count, std::memory_order_release);
+	for(int r: roots) pool.submitJob([this, r] () {runNode(r);});
+}
+
+void TaskGraph::wait() {
+	std::unique_lock<std::mutex> l(done_lock);
+	done_notify.wait(l, [this] () {return done;});
+	if(error) std::rethrow_exception(error);
+}
+
+int TaskGraph::getNodeCount() {
+	return (int)nodes.size();
+}
+
+void TaskGraph::runNode(int node) {
+	while(node != -1) {
+		if(failed.load(std::memory_order_relaxed) == false) {
+			try {
+				nodes[node]();
+			}
+			catch(...) {
+				if(failed.exchange(true) == false) error = std::current_exception();
+			}
+		}
+		//Release successors.  We keep the first one that becomes ready for ourselves.
+		int next = -1;
+		for(int i = successor_offsets[node]; i < successor_offsets[node+1]; i++) {
+			int s = successors[i];
+			if(pending[s].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+				if(next == -1) next = s;
+				else pool->submitJob([this, s] () {runNode(s);});
+			}
+		}
+		if(remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			std::lock_guard<std::mutex> l(done_lock);
+			done = true;
+			done_notify.notify_all();
+		}
+		node = next;
+	}
+}
+
+}
@@ -0,0 +1,59 @@
+#include <powercores/thread_local_variable.hpp>
+#include <mutex>
+#include <vector>
+#include <utility>
+
+namespace powercores {
+
+//Set once the holder has run, so that variables used by later thread_local destructors get a table which nobody deletes, rather than a second holder.
+static thread_local bool thread_table_dead = false;
+
+class ThreadLocalSlotTableHolder {
+	public:
+	//Runs at thread exit, and deletes every value this thread created.
+	~ThreadLocalSlotTableHolder() {
+		auto table = threadLocalSlotTable();
+		//A deleter might use another ThreadLocalVariable, so get the slots out of the table first, and go round again if that made more.
+		while(table->slots.empty() == false) {
+			std::vector<ThreadLocalSlot> dying;
+			dying.swap(table->slots);
+			for(auto &i: dying) delete i.owner;
+		}
+		thread_table_dead = true;
+		threadLocalSlotTable() = nullptr;
+		delete table;
+	}
+};
+
+ThreadLocalSlotTable* createThreadLocalSlotTable() {
+	auto table = new ThreadLocalSlotTable();
+	threadLocalSlotTable() = table;
+	if(thread_table_dead == false) {
+		//Constructed on first use, like the pool allocator's holder, so it's destroyed before thread_local objects created earlier.
+		static thread_local ThreadLocalSlotTableHolder holder;
+	}
+	return table;
+}
+
+//Indices are reused, generations are not.  This is only touched when variables are created and destroyed.
+static std::mutex slot_allocation_lock;
+static std::vector<unsigned int> free_slots;
+static unsigned int next_slot = 0;
+static unsigned long long next_generation = 1;
+
+void allocateThreadLocalSlot(unsigned int &index, unsigned long long &generation) {
+	std::lock_guard<std::mutex> l(slot_allocation_lock);
+	if(free_slots.empty()) index = next_slot++;
+	else {
+		index = free_slots.back();
+		free_slots.pop_back();
+	}
+	generation = next_generation++;
+}
+
+void freeThreadLocalSlot(unsigned int index) {
+	std::lock_guard<std::mutex> l(slot_allocation_lock);
+	free_slots.push_back(index);
+}
+
+}
@@ -0,0 +1,155 @@
+#include <powercores/thread_placement.hpp>
+#include <vector>
+#include <map>
+#include <utility>
+#include <algorithm>
+#include <tuple>
+#include <thread>
+#include <string>
+#include <stdio.h>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+namespace powercores {
+
+#ifdef __linux__
+//Read the first line of a sysfs file.
+static bool readLine(const std::string &path, std::string &out) {
+	FILE* f = fopen(path.c_str(), "r");
+	if(f == nullptr) return false;
+	char buffer[4096];
+	bool ret = fgets(buffer, sizeof(buffer), f) != nullptr;
+	fclose(f);
+	if(ret) out = buffer;
+	return ret;
+}
+
+static bool readInt(const std::string &path, int &out) {
+	std::string line;
+	if(readLine(path, line) == false) return false;
+	return sscanf(line.c_str(), "%i", &out) == 1;
+}
+
+//The kernel's list format: 0-3,8,10-11
+static std::vector<int> parseCpuList(const std::string &list) {
+	std::vector<int> ret;
+	const char* s = list.c_str();
+	while(*s) {
+		int first, last, consumed;
+		if(sscanf(s, "%i%n", &first, &consumed) != 1) break;
+		s += consumed;
+		last = first;
+		if(*s == '-') {
+			s++;
+			if(sscanf(s, "%i%n", &last, &consumed) != 1) break;
+			s += consumed;
+		}
+		for(int i = first; i <= last; i++) ret.push_back(i);
+		if(*s != ',') break;
+		s++;
+	}
+	return ret;
+}
+#endif
+
+CpuTopology CpuTopology::detect() {
+	CpuTopology ret;
+#ifdef __linux__
+	std::string online, line;
+	if(readLine("/sys/devices/system/cpu/online", online)) {
+		std::map<int, int> nodes;
+		if(readLine("/sys/devices/system/node/online", line)) {
+			for(int node: parseCpuList(line)) {
+				std::string cpulist;
+				if(readLine("/sys/devices/system/node/node"+std::to_string(node)+"/cpulist", cpulist) == false) continue;
+				for(int cpu: parseCpuList(cpulist)) nodes[cpu] = node;
+			}
+		}
+		for(int id: parseCpuList(online)) {
+			CpuInfo info;
+			info.id = id;
+			info.core = id;
+			std::string base = "/sys/devices/system/cpu/cpu"+std::to_string(id)+"/topology/";
+			readInt(base+"core_id", info.core);
+			readInt(base+"physical_package_id", info.package);
+			if(nodes.count(id)) info.numa_node = nodes[id];
+			ret.cpus.push_back(info);
+		}
+	}
+#endif
+	if(ret.cpus.empty()) {
+		int count = std::max(1u, std::thread::hardware_concurrency());
+		for(int i = 0; i < count; i++) {
+			CpuInfo info;
+			info.id = i;
+			info.core = i;
+			ret.cpus.push_back(info);
+		}
+	}
+	return ret;
+}
+
+std::vector<int> CpuTopology::spreadOrder() const {
+	//Rank each CPU among the hyperthreads of its core, and its core among the cores of its package.
+	std::map<std::pair<int, int>, int> threadsSeen;
+	std::map<std::pair<int, int>, int> coreRanks;
+	std::map<int, int> coresSeen;
+	std::vector<CpuInfo> sorted = cpus;
+	std::sort(sorted.begin(), sorted.end(), [] (const CpuInfo &a, const CpuInfo &b) {return a.id < b.id;});
+	//(thread rank, core rank, package, id)
+	std::vector<std::tuple<int, int, int, int>> keys;
+	for(auto &cpu: sorted) {
+		auto core = std::make_pair(cpu.package, cpu.core);
+		if(coreRanks.count(core) == 0) coreRanks[core] = coresSeen[cpu.package]++;
+		keys.emplace_back(threadsSeen[core]++, coreRanks[core], cpu.package, cpu.id);
+	}
+	std::sort(keys.begin(), keys.end());
+	std::vector<int> ret;
+	for(auto &k: keys) ret.push_back(std::get<3>(k));
+	return ret;
+}
+
+bool pinCurrentThread(int cpu) {
+#ifdef __linux__
+	if(cpu < 0 || cpu >= CPU_SETSIZE) return false;
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#elif defined(_WIN32)
+	if(cpu < 0 || cpu >= (int)sizeof(DWORD_PTR)*8) return false;
+	return SetThreadAffinityMask(GetCurrentThread(), ((DWORD_PTR)1) << cpu) != 0;
+#else
+	return false;
+#endif
+}
+
+bool setCurrentThreadScheduling(ThreadScheduling policy, int priority) {
+	if(policy == ThreadScheduling::DEFAULT) return true;
+#ifdef __linux__
+	if(policy == ThreadScheduling::FIFO) {
+		sched_param param;
+		param.sched_priority = priority;
+		return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+	}
+	//On Linux, nice values belong to threads rather than processes.
+	return setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), priority) == 0;
+#elif defined(_WIN32)
+	int p = THREAD_PRIORITY_NORMAL;
+	if(policy == ThreadScheduling::FIFO) p = THREAD_PRIORITY_TIME_CRITICAL;
+	else if(priority < 0) p = THREAD_PRIORITY_ABOVE_NORMAL;
+	else if(priority > 0) p = THREAD_PRIORITY_BELOW_NORMAL;
+	return SetThreadPriority(GetCurrentThread(), p) != 0;
+#else
+	return false;
+#endif
+}
+
+}
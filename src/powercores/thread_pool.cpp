@@ -1,5 +1,13 @@
 #include <powercores/exceptions.hpp>
+#include <powercores/barrier.hpp>
+#include <powercores/epoch.hpp>
 #include <powercores/threadsafe_queue.hpp>
+#include <powercores/job_queue.hpp>
+#include <powercores/pool_allocator.hpp>
+#include <powercores/task.hpp>
+#include <powercores/thread_placement.hpp>
+#include <powercores/thread_pool_stats.hpp>
+#include <powercores/timer_wheel.hpp>
 #include <powercores/utilities.hpp>
 #include <powercores/thread_pool.hpp>
 #include <thread>
@@ -11,82 +19,539 @@
 #include <future>
 #include <type_traits>
 #include <system_error>
+#include <memory>
+#include <algorithm>
 
 
 namespace powercores {
 
+//The pool and worker the calling thread belongs to, if it is a worker.
+static thread_local ThreadPool* current_pool = nullptr;
+static thread_local int current_worker = -1;
+//Without work stealing, workers take jobs from their queues in batches.  These are the batch the calling worker is running, and the next entry to start, so that waitFor can run entries which nobody else can see.
+static thread_local JobQueue::Entry* current_batch = nullptr;
+static thread_local int current_batch_next = 0, current_batch_size = 0;
+
 ThreadPool::ThreadPool(int threadCount): thread_count(threadCount) {
 	running.store(0);
 }
 
 ThreadPool::~ThreadPool() {
 	if(running.load()) stop();
+	delete timer_wheel.exchange(nullptr);
+	for(auto i: worker_stats) delete i;
+}
+
+static long long nowNs() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
 }
 
 void ThreadPool::start() {
 	running.store(1);
-	job_queues.resize(thread_count);
-	for(auto &i: job_queues) i = new ThreadsafeQueue<std::function<void(void)>>();
-	for(int i = 0; i < thread_count; i++) {
-		threads.emplace_back(safeStartThread(&ThreadPool::workerThreadFunction, this, i));
+	int count = thread_count.load();
+	if(auto_scaling) count = std::min(std::max(count, auto_scaling_min), auto_scaling_max);
+	//Room to grow without a restart.
+	max_workers = std::max(count, std::max(auto_scaling ? auto_scaling_max : 0, 64));
+	job_queues.assign(max_workers, nullptr);
+	for(auto i: worker_stats) delete i;
+	worker_stats.assign(max_workers, nullptr);
+	threads.resize(max_workers);
+	live_workers.store(0);
+	thread_count.store(0);
+	if(worker_affinity == WorkerAffinity::CPUS) placement_cpus = worker_cpus;
+	else if(worker_affinity == WorkerAffinity::SPREAD) placement_cpus = CpuTopology::detect().spreadOrder();
+	else placement_cpus.clear();
+	started_workers = 0;
+	resize(count);
+	if(auto_scaling) {
+		scaler_stopping = false;
+		scaler_thread = safeStartThread(&ThreadPool::autoScalerThreadFunction, this);
 	}
 }
 
+void ThreadPool::workerMain(int id, int cpu) {
+	current_pool = this;
+	current_worker = id;
+	if(cpu != -1 && pinCurrentThread(cpu) == false) cpu = -1;
+	bool scheduled = setCurrentThreadScheduling(worker_scheduling, worker_priority);
+	//Allocated after pinning, so that they're on our NUMA node.
+	auto stats = new WorkerStats();
+	stats->cpu = cpu;
+	stats->scheduling_applied = scheduled;
+	worker_stats[id] = stats;
+	if(job_queue_backend == JobQueueBackend::LOCK_FREE) job_queues[id] = new LockFreeJobQueue(job_queue_capacity, wait_policy, starvation_limit);
+	else job_queues[id] = new LockingJobQueue(wait_policy, starvation_limit);
+	{
+		std::lock_guard<std::mutex> l(start_lock);
+		started_workers++;
+		start_notify.notify_all();
+	}
+	if(work_stealing) workStealingThreadFunction(id);
+	else workerThreadFunction(id);
+}
+
 void ThreadPool::stop() {
-	for(auto &i: job_queues) i->enqueue([] () {throw ThreadPoolPoisonException();});
+	if(scaler_thread.joinable()) {
+		{
+			std::lock_guard<std::mutex> l(scaler_lock);
+			scaler_stopping = true;
+			scaler_notify.notify_all();
+		}
+		scaler_thread.join();
+	}
+	//Before the workers go, so that no timer fires into a stopped pool.
+	delete timer_wheel.exchange(nullptr);
+	//Retired workers are still there, asleep, and need poisoning too.
+	int live = live_workers.load();
+	for(int i = 0; i < live; i++) enqueueJob(i, [] () {throw ThreadPoolPoisonException();}, true);
 	running.store(0);
-	for(int i = 0; i < threads.size(); i++) {
+	for(int i = 0; i < live; i++) {
 		threads[i].join();
 	}
 	threads.clear();
 	for(auto &i: job_queues) delete i;
 	job_queues.clear();
-	job_queue_pointer = 0;
 }
 
 void ThreadPool::setThreadCount(int n) {
-	bool wasRunning = running.load() == 1;
-	if(wasRunning)  stop();
-	thread_count = n;
-	if(wasRunning) start();
+	//Submissions divide by the number of workers.
+	n = std::max(n, 1);
+	if(running.load() == 1 && n <= max_workers) {
+		if(auto_scaling) n = std::min(std::max(n, auto_scaling_min), auto_scaling_max);
+		resize(n);
+		return;
+	}
+	restartAround([&] () {
+		thread_count = n;
+	});
+}
+
+int ThreadPool::getThreadCount() {
+	return thread_count.load();
+}
+
+void ThreadPool::resize(int n) {
+	//Also reached from start, with whatever the constructor was given.
+	n = std::max(n, 1);
+	std::lock_guard<std::mutex> l(resize_lock);
+	int old = thread_count.load();
+	if(n == old) return;
+	int live = live_workers.load();
+	//Start workers which have never run.
+	for(int i = live; i < n; i++) {
+		threads[i] = safeStartThread(&ThreadPool::workerMain, this, i, placement_cpus.empty() ? -1 : placement_cpus[i%placement_cpus.size()]);
+	}
+	if(n > live) {
+		std::unique_lock<std::mutex> l2(start_lock);
+		start_notify.wait(l2, [&] () {return started_workers == n;});
+		live_workers.store(n);
+		//Barriers already submitted keep the Barrier they were submitted with, and with it the old count.
+		barrier = std::allocate_shared<Barrier>(PoolAllocator<Barrier>(), n);
+	}
+	thread_count.store(n);
+	//Retired workers which are coming back may be asleep on their own queues.
+	for(int i = old; i < std::min(n, live); i++) enqueueJob(i, [] () {}, true);
+	if(work_stealing) wakeIdleWorkers(true);
+}
+
+void ThreadPool::setAutoScaling(int minThreads, int maxThreads, std::chrono::milliseconds quietPeriod) {
+	restartAround([&] () {
+		auto_scaling = true;
+		auto_scaling_min = std::max(1, minThreads);
+		auto_scaling_max = std::max(auto_scaling_min, maxThreads);
+		auto_scaling_quiet_period = quietPeriod;
+	});
+}
+
+void ThreadPool::disableAutoScaling() {
+	restartAround([&] () {
+		auto_scaling = false;
+	});
+}
+
+bool ThreadPool::getAutoScaling() {
+	return auto_scaling;
+}
+
+void ThreadPool::autoScalerThreadFunction() {
+	const auto tick = std::chrono::milliseconds(10);
+	auto quietTicks = std::max<long long>(1, auto_scaling_quiet_period.count()/tick.count());
+	long long quiet = 0;
+	std::unique_lock<std::mutex> l(scaler_lock);
+	while(scaler_stopping == false) {
+		scaler_notify.wait_for(l, tick);
+		if(scaler_stopping) break;
+		int count = thread_count.load();
+		unsigned int queued = 0;
+		for(int i = 0; i < count; i++) queued += job_queues[i]->size();
+		int idle = idle_workers.load();
+		if(queued > (unsigned int)count && idle == 0) {
+			quiet = 0;
+			if(count < auto_scaling_max) resize(count+1);
+		}
+		else if(queued == 0 && idle > 0) {
+			if(++quiet >= quietTicks) {
+				quiet = 0;
+				if(count > auto_scaling_min) resize(count-1);
+			}
+		}
+		else quiet = 0;
+	}
+}
+
+void ThreadPool::setWorkStealing(bool enabled) {
+	restartAround([&] () {
+		work_stealing = enabled;
+	});
+}
+
+bool ThreadPool::getWorkStealing() {
+	return work_stealing;
+}
+
+void ThreadPool::setJobQueueBackend(JobQueueBackend backend, unsigned int capacity) {
+	restartAround([&] () {
+		job_queue_backend = backend;
+		job_queue_capacity = capacity;
+	});
+}
+
+JobQueueBackend ThreadPool::getJobQueueBackend() {
+	return job_queue_backend;
+}
+
+void ThreadPool::setWorkerAffinity(WorkerAffinity affinity, std::vector<int> cpus) {
+	restartAround([&] () {
+		worker_affinity = affinity;
+		worker_cpus = cpus;
+	});
+}
+
+WorkerAffinity ThreadPool::getWorkerAffinity() {
+	return worker_affinity;
+}
+
+void ThreadPool::setWorkerScheduling(ThreadScheduling policy, int priority) {
+	restartAround([&] () {
+		worker_scheduling = policy;
+		worker_priority = priority;
+	});
+}
+
+ThreadScheduling ThreadPool::getWorkerScheduling() {
+	return worker_scheduling;
+}
+
+void ThreadPool::setWaitPolicy(WaitPolicy policy) {
+	restartAround([&] () {
+		wait_policy = policy;
+	});
+}
+
+WaitPolicy ThreadPool::getWaitPolicy() {
+	return wait_policy;
+}
+
+void ThreadPool::setExceptionHandler(std::function<void(std::exception_ptr)> handler) {
+	std::shared_ptr<const std::function<void(std::exception_ptr)>> h;
+	if(handler) h = std::make_shared<const std::function<void(std::exception_ptr)>>(std::move(handler));
+	std::atomic_store(&exception_handler, h);
+}
+
+void ThreadPool::setStarvationLimit(int limit) {
+	restartAround([&] () {
+		starvation_limit = limit;
+	});
+}
+
+int ThreadPool::getStarvationLimit() {
+	return starvation_limit;
+}
+
+ThreadPoolStats ThreadPool::getStats() {
+	ThreadPoolStats ret;
+	int live = live_workers.load();
+	ret.workers.resize(live);
+	for(int i = 0; i < live; i++) {
+		worker_stats[i]->snapshot(ret.workers[i], ret.latency_histogram);
+		if(i < (int)job_queues.size()) ret.workers[i].queue_depth = job_queues[i]->size();
+	}
+	return ret;
+}
+
+void ThreadPool::resetStats() {
+	for(int i = 0; i < live_workers.load(); i++) worker_stats[i]->reset();
+}
+
+void ThreadPool::setStatsEnabled(bool enabled) {
+	stats_enabled.store(enabled);
+}
+
+bool ThreadPool::getStatsEnabled() {
+	return stats_enabled.load();
 }
 
 void ThreadPool::submitBarrier() {
-	//Promises are not copyable, so we save a pointer and delete it later, after the barrier.
-	auto promise = new std::promise<void>();
-	std::shared_future<void> future(promise->get_future());
-	auto counter = new std::atomic<int>();
-	counter->store(0);
-	int goal = thread_count;
-	auto barrierJob = [counter, promise, future, goal] () {
-		int currentCounter = counter->fetch_add(1); //increment by one and get the current counter.
-		if(currentCounter == goal-1) { //we're finished.
-			promise->set_value();
-			delete promise; //we're done, this isn't needed anymore.
-			//We got here, so we're the last one to manipulate the counter.
-			delete counter;
+	std::lock_guard<std::mutex> l(resize_lock);
+	//Every worker must run exactly one of these, so they are pinned.
+	//Retired workers may still have jobs from before they retired, so they take part too.
+	//Copying the pointer keeps the Barrier alive, even if the pool grows before everyone has arrived.
+	auto b = barrier;
+	int live = live_workers.load();
+	for(int i = 0; i < live; i++) enqueueJob(i, Task([b] () {b->arriveAndWait();}), true);
+}
+
+
+void ThreadPool::waitForBarrier() {
+	submitBarrier();
+	waitFor(submitJobWithFuture([] () {}));
+}
+
+bool ThreadPool::runPendingJob() {
+	int live = live_workers.load(std::memory_order_acquire);
+	if(live == 0) return false;
+	//Workers look in their own queue first, since that's where their sub-jobs usually are.
+	bool worker = current_pool == this && current_worker < live;
+	//The rest of our own batch comes first: it's older than anything queued, and only we can run it.  Like thieves, we stop at a pinned entry.
+	if(worker && current_batch_next < current_batch_size && current_batch[current_batch_next].pinned == false) {
+		auto &entry = current_batch[current_batch_next++];
+		runJob(entry.job, worker_stats[current_worker]);
+		worker_stats[current_worker]->jobs_executed.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+	int first = worker ? current_worker : 0;
+	JobQueue::Entry job;
+	for(int i = 0; i < live; i++) {
+		auto &queue = *job_queues[(first+i)%live];
+		//Our workers can't pass a barrier while running a job, but anyone else can, so their jobs are tracked by the queue.
+		if((worker ? queue.trySteal(job) : queue.tryStealExternal(job)) == false) continue;
+		runJob(job.job, worker ? worker_stats[current_worker] : nullptr);
+		if(worker) worker_stats[current_worker]->jobs_executed.fetch_add(1, std::memory_order_relaxed);
+		else queue.finishExternal();
+		return true;
+	}
+	return false;
+}
+
+bool ThreadPool::hasPendingJob() {
+	int live = live_workers.load(std::memory_order_acquire);
+	bool worker = current_pool == this && current_worker < live;
+	if(worker && current_batch_next < current_batch_size && current_batch[current_batch_next].pinned == false) return true;
+	for(int i = 0; i < live; i++) {
+		auto &queue = *job_queues[i];
+		if(queue.empty()) continue;
+		if(worker ? queue.canSteal() : queue.canStealExternal()) return true;
+	}
+	return false;
+}
+
+TimerWheel& ThreadPool::getTimerWheel() {
+	auto wheel = timer_wheel.load(std::memory_order_acquire);
+	if(wheel) return *wheel;
+	std::lock_guard<std::mutex> l(timer_wheel_lock);
+	wheel = timer_wheel.load();
+	if(wheel == nullptr) {
+		wheel = new TimerWheel([this] (TimerNode* node) {fireTimer(node);});
+		timer_wheel.store(wheel, std::memory_order_release);
+	}
+	return *wheel;
+}
+
+void ThreadPool::fireTimer(TimerNode* node) {
+	if(node->period && node->running.exchange(true)) return;
+	node->references.fetch_add(1, std::memory_order_relaxed);
+	submitJob(node->priority, [node] () {
+		try {
+			node->job();
 		}
-		else {
-			//Otherwise, we wait for all the other barriers.
-			future.wait();
+		catch(...) {
+			node->running.store(false);
+			node->release();
+			throw;
 		}
-	};
-	for(int i = 0; i < thread_count; i++) submitJob(barrierJob);
+		node->running.store(false);
+		node->release();
+	});
+}
+
+int ThreadPool::pickWorker() {
+	//Acquire, so that the queues of workers which just started are visible.
+	int count = thread_count.load(std::memory_order_acquire);
+	if(work_stealing && current_pool == this && current_worker < count) return current_worker;
+	//Start each thread somewhere different, so that threads which each submit one job don't all pick worker 0.
+	static thread_local unsigned int next = (unsigned int)std::hash<std::thread::id>()(std::this_thread::get_id());
+	//The pool may have shrunk since we last submitted.
+	return (next++)%count;
+}
+
+void ThreadPool::runJob(Task &job, WorkerStats* stats) {
+	try {
+		job();
+	}
+	catch(ThreadPoolPoisonException &) {
+		throw;
+	}
+	catch(...) {
+		if(stats) stats->exceptions.fetch_add(1, std::memory_order_relaxed);
+		//Our own reference, so the handler stays alive even if it's replaced while it runs.
+		auto handler = std::atomic_load(&exception_handler);
+		if(handler) {
+			try {
+				(*handler)(std::current_exception());
+			}
+			catch(...) {
+			}
+		}
+	}
+	//Between jobs is a natural time to free what this worker has retired.
+	epochQuiescentPoint();
+}
+
+void ThreadPool::enqueueJob(int worker, Task job, bool pinned, JobPriority priority) {
+	unsigned int depth = job_queues[worker]->enqueue(JobQueue::Entry(std::move(job), pinned, submitTimestamp(), priority));
+	worker_stats[worker]->noteQueueDepth(depth);
+	if(work_stealing) wakeIdleWorkers(pinned);
+}
+
+long long ThreadPool::submitTimestamp() {
+	return stats_enabled.load(std::memory_order_relaxed) ? nowNs() : 0;
 }
 
 void ThreadPool::workerThreadFunction(int id) {
-	ThreadsafeQueue<std::function<void(void)>> &job_queue = *job_queues[id];
+	JobQueue &job_queue = *job_queues[id];
+	WorkerStats &stats = *worker_stats[id];
 	int jobsSize = 5;
-	std::function<void(void)> jobs[5];
+	JobQueue::Entry jobs[5];
+	current_batch = jobs;
+	long long idleSince = nowNs();
 	try {
 		while(true) {
-			int got = job_queue.dequeueRange(jobsSize, jobs);
-			for(int i = 0; i < got; i++) jobs[i]();
+			int got = job_queue.tryDequeueRange(jobsSize, jobs);
+			if(got == 0) {
+				//Retired workers aren't available to parallelFor.
+				bool active = id < thread_count.load(std::memory_order_relaxed);
+				if(active) idle_workers.fetch_add(1);
+				got = job_queue.dequeueRange(jobsSize, jobs);
+				if(active) idle_workers.fetch_sub(1);
+				stats.wakeups.fetch_add(1, std::memory_order_relaxed);
+			}
+			bool statsOn = stats_enabled.load(std::memory_order_relaxed);
+			long long busySince = statsOn ? nowNs() : 0;
+			if(statsOn) stats.idle_ns.fetch_add(busySince-idleSince, std::memory_order_relaxed);
+			//Jobs in the batch may run the rest of it from waitFor, so the position is shared with runPendingJob.
+			current_batch_size = got;
+			current_batch_next = 0;
+			while(current_batch_next < current_batch_size) {
+				auto &job = jobs[current_batch_next++];
+				if(statsOn && job.submitted) stats.recordLatency(nowNs()-job.submitted);
+				if(job.pinned) job_queue.waitForExternal();
+				runJob(job.job, &stats);
+				if(job.pinned) job_queue.finishPinned();
+				stats.jobs_executed.fetch_add(1, std::memory_order_relaxed);
+			}
+			if(statsOn) {
+				idleSince = nowNs();
+				stats.busy_ns.fetch_add(idleSince-busySince, std::memory_order_relaxed);
+			}
 		}
 	}
 	catch(ThreadPoolPoisonException) {
 		//Nothing, just a way to break out.
 	}
+	current_batch = nullptr;
+	current_batch_size = 0;
+}
+
+void ThreadPool::workStealingThreadFunction(int id) {
+	JobQueue &job_queue = *job_queues[id];
+	WorkerStats &stats = *worker_stats[id];
+	JobQueue::Entry job;
+	long long idleSince = nowNs();
+	try {
+		while(true) {
+			bool retired = id >= thread_count.load(std::memory_order_relaxed);
+			if(retired) {
+				//Run what's left in our own queue, and sleep on it until the pool grows again or stops.
+				job_queue.dequeueRange(1, &job);
+			}
+			else {
+				//Before running a pinned job, which is usually a barrier, help finish whatever is still ahead of the other workers' barriers.
+				int got = 0;
+				if(job_queue.pinnedNext()) got = stealJob(id, job);
+				//One at a time, so that we never hoard work another worker could be doing.
+				if(got == 0) got = job_queue.tryDequeueRange(1, &job);
+				if(got == 0) got = stealJob(id, job);
+				if(got == 0) {
+					parkIdleWorker(id);
+					continue;
+				}
+				//If we left work behind and someone is asleep, let them have it.
+				if(job.pinned == false && parked_workers.load() && job_queue.canSteal()) wakeIdleWorkers(false);
+			}
+			bool statsOn = stats_enabled.load(std::memory_order_relaxed);
+			long long busySince = statsOn ? nowNs() : 0;
+			if(statsOn) {
+				stats.idle_ns.fetch_add(busySince-idleSince, std::memory_order_relaxed);
+				if(job.submitted) stats.recordLatency(busySince-job.submitted);
+			}
+			if(job.pinned) job_queue.waitForExternal();
+			runJob(job.job, &stats);
+			if(job.pinned) job_queue.finishPinned();
+			stats.jobs_executed.fetch_add(1, std::memory_order_relaxed);
+			if(statsOn) {
+				idleSince = nowNs();
+				stats.busy_ns.fetch_add(idleSince-busySince, std::memory_order_relaxed);
+			}
+		}
+	}
+	catch(ThreadPoolPoisonException) {
+	}
+}
+
+bool ThreadPool::stealJob(int id, JobQueue::Entry &output) {
+	//Retired workers' queues are included, so that whatever they have left gets done sooner.
+	int live = live_workers.load(std::memory_order_acquire);
+	for(int i = 1; i < live; i++) {
+		if(job_queues[(id+i)%live]->trySteal(output)) return true;
+	}
+	return false;
+}
+
+void ThreadPool::parkIdleWorker(int id) {
+	idle_workers.fetch_add(1);
+	int live = live_workers.load(std::memory_order_acquire);
+	//Work is our own queue, or a job we could steal.  A queue holding only a barrier or other pinned job doesn't count, or we'd spin until its owner got to it.
+	auto haveWorkFor = [&] () {
+		if(job_queues[id]->empty() == false) return true;
+		if(work_stealing == false) return false;
+		for(int i = 1; i < live; i++) {
+			//empty never takes a lock, so spinning on empty queues stays out of the submitters' way.
+			auto &q = *job_queues[(id+i)%live];
+			if(q.empty() == false && q.canSteal()) return true;
+		}
+		return false;
+	};
+	bool haveWork = wait_policy.wait(haveWorkFor);
+	if(haveWork == false) {
+		std::unique_lock<std::mutex> l(idle_lock);
+		parked_workers.fetch_add(1);
+		auto version = idle_version;
+		//Submitters check parked_workers after enqueueing, so either they see us or we see their job here.
+		haveWork = haveWorkFor();
+		if(haveWork == false) idle_notify.wait(l, [&] () {return idle_version != version;});
+		parked_workers.fetch_sub(1);
+	}
+	idle_workers.fetch_sub(1);
+	worker_stats[id]->wakeups.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ThreadPool::wakeIdleWorkers(bool all) {
+	//Spinning workers will find the job themselves.
+	if(parked_workers.load() == 0) return;
+	std::lock_guard<std::mutex> l(idle_lock);
+	idle_version++;
+	if(all) idle_notify.notify_all();
+	else idle_notify.notify_one();
 }
 
 }
\ No newline at end of file
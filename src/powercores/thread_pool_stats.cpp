@@ -0,0 +1,65 @@
+#include <powercores/thread_pool_stats.hpp>
+#include <atomic>
+#include <vector>
+
+namespace powercores {
+
+unsigned long long ThreadPoolStats::getJobsExecuted() {
+	unsigned long long ret = 0;
+	for(auto &i: workers) ret += i.jobs_executed;
+	return ret;
+}
+
+unsigned long long ThreadPoolStats::latencyPercentile(double p) {
+	unsigned long long total = 0;
+	for(int i = 0; i < LATENCY_BUCKETS; i++) total += latency_histogram[i];
+	if(total == 0) return 0;
+	unsigned long long goal = (unsigned long long)(p*total), seen = 0;
+	for(int i = 0; i < LATENCY_BUCKETS; i++) {
+		seen += latency_histogram[i];
+		if(seen > goal || seen == total) return 2ull << i;
+	}
+	return 2ull << (LATENCY_BUCKETS-1);
+}
+
+WorkerStats::WorkerStats() {
+	reset();
+}
+
+void WorkerStats::recordLatency(long long ns) {
+	int bucket = 0;
+	unsigned long long v = ns > 0 ? (unsigned long long)ns : 0;
+	while(v >>= 1) bucket++;
+	if(bucket >= ThreadPoolStats::LATENCY_BUCKETS) bucket = ThreadPoolStats::LATENCY_BUCKETS-1;
+	latency_histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+void WorkerStats::noteQueueDepth(unsigned int depth) {
+	unsigned int old = max_queue_depth.load(std::memory_order_relaxed);
+	//Usually the depth isn't a new maximum, and we never get past this check.
+	while(depth > old && max_queue_depth.compare_exchange_weak(old, depth, std::memory_order_relaxed) == false);
+}
+
+void WorkerStats::reset() {
+	jobs_executed.store(0, std::memory_order_relaxed);
+	busy_ns.store(0, std::memory_order_relaxed);
+	idle_ns.store(0, std::memory_order_relaxed);
+	wakeups.store(0, std::memory_order_relaxed);
+	exceptions.store(0, std::memory_order_relaxed);
+	for(auto &i: latency_histogram) i.store(0, std::memory_order_relaxed);
+	max_queue_depth.store(0, std::memory_order_relaxed);
+}
+
+void WorkerStats::snapshot(ThreadPoolStats::Worker &worker, unsigned long long* histogram) {
+	worker.jobs_executed = jobs_executed.load(std::memory_order_relaxed);
+	worker.busy_ns = busy_ns.load(std::memory_order_relaxed);
+	worker.idle_ns = idle_ns.load(std::memory_order_relaxed);
+	worker.wakeups = wakeups.load(std::memory_order_relaxed);
+	worker.exceptions = exceptions.load(std::memory_order_relaxed);
+	worker.max_queue_depth = max_queue_depth.load(std::memory_order_relaxed);
+	worker.cpu = cpu;
+	worker.scheduling_applied = scheduling_applied;
+	for(int i = 0; i < ThreadPoolStats::LATENCY_BUCKETS; i++) histogram[i] += latency_histogram[i].load(std::memory_order_relaxed);
+}
+
+}
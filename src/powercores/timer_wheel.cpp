@@ -0,0 +1,160 @@
+#include <powercores/timer_wheel.hpp>
+#include <powercores/utilities.hpp>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <algorithm>
+
+namespace powercores {
+
+const std::chrono::milliseconds TimerWheel::TICK(1);
+
+TimerWheel::TimerWheel(std::function<void(TimerNode*)> fire): fire(fire), epoch(Clock::now()) {
+	for(auto &level: slots) {
+		for(auto &slot: level) slot = nullptr;
+	}
+	next_wake.store(std::numeric_limits<long long>::max());
+	thread = safeStartThread(&TimerWheel::threadFunction, this);
+}
+
+TimerWheel::~TimerWheel() {
+	{
+		std::lock_guard<std::mutex> l(lock);
+		stopping = true;
+		wake.notify_all();
+	}
+	thread.join();
+	drainInbox();
+	for(auto &level: slots) {
+		for(auto &slot: level) {
+			while(slot) {
+				auto next = slot->next;
+				slot->release();
+				slot = next;
+			}
+		}
+	}
+}
+
+void TimerWheel::add(TimerNode* node, Clock::time_point when) {
+	node->expires = tickOf(when, true);
+	auto head = inbox.load();
+	do {
+		node->next = head;
+	} while(inbox.compare_exchange_weak(head, node) == false);
+	//Both this and the thread's store of next_wake are sequentially consistent, so either the thread sees our node before it sleeps or we see when it plans to wake.
+	long long when_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(when-epoch).count();
+	if(when_ns < next_wake.load()) {
+		std::lock_guard<std::mutex> l(lock);
+		wake.notify_one();
+	}
+}
+
+unsigned long long TimerWheel::tickOf(Clock::time_point t, bool roundUp) {
+	auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t-epoch).count();
+	if(ns <= 0) return 0;
+	long long tick_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(TICK).count();
+	return roundUp ? (ns+tick_ns-1)/tick_ns : ns/tick_ns;
+}
+
+TimerWheel::Clock::time_point TimerWheel::timeOf(unsigned long long tick) {
+	return epoch+TICK*tick;
+}
+
+void TimerWheel::threadFunction() {
+	while(true) {
+		drainInbox();
+		auto now = tickOf(Clock::now(), false);
+		while(current_tick < now) {
+			advance();
+		}
+		auto wakeTick = nextWakeTick();
+		Clock::time_point wakeTime = timeOf(wakeTick);
+		next_wake.store(wakeTick ? std::chrono::duration_cast<std::chrono::nanoseconds>(wakeTime-epoch).count() : std::numeric_limits<long long>::max());
+		std::unique_lock<std::mutex> l(lock);
+		if(stopping) break;
+		if(inbox.load() != nullptr) continue;
+		if(wakeTick) wake.wait_until(l, wakeTime);
+		else wake.wait(l);
+		if(stopping) break;
+	}
+}
+
+void TimerWheel::drainInbox() {
+	auto node = inbox.exchange(nullptr);
+	while(node) {
+		auto next = node->next;
+		//Already due: the current tick's slot has been done, so it fires on the next one.
+		node->expires = std::max(node->expires, current_tick+1);
+		insert(node);
+		timer_count++;
+		node = next;
+	}
+}
+
+void TimerWheel::insert(TimerNode* node) {
+	unsigned long long expires = node->expires;
+	unsigned long long delta = expires > current_tick ? expires-current_tick : 0;
+	int level = 0;
+	while(level < LEVELS-1 && delta >= (1ull << (SLOT_BITS*(level+1)))) level++;
+	//Too far off for the top level: park it as far out as possible, and it will be placed again when it gets there.
+	if(delta >= (1ull << (SLOT_BITS*LEVELS))) expires = current_tick+(1ull << (SLOT_BITS*LEVELS))-1;
+	auto &slot = slots[level][(expires >> (SLOT_BITS*level))&(SLOTS-1)];
+	node->next = slot;
+	slot = node;
+}
+
+void TimerWheel::advance() {
+	current_tick++;
+	//When a level wraps, the next slot of the level above is spread over the levels below.
+	for(int level = 1; level < LEVELS; level++) {
+		if((current_tick >> (SLOT_BITS*(level-1)))&(SLOTS-1)) break;
+		auto &slot = slots[level][(current_tick >> (SLOT_BITS*level))&(SLOTS-1)];
+		auto node = slot;
+		slot = nullptr;
+		while(node) {
+			auto next = node->next;
+			insert(node);
+			node = next;
+		}
+	}
+	auto &slot = slots[0][current_tick&(SLOTS-1)];
+	auto node = slot;
+	slot = nullptr;
+	while(node) {
+		auto next = node->next;
+		expire(node);
+		node = next;
+	}
+}
+
+void TimerWheel::expire(TimerNode* node) {
+	if(node->period == 0) {
+		int expected = TimerNode::PENDING;
+		if(node->state.compare_exchange_strong(expected, TimerNode::FIRED)) fire(node);
+		timer_count--;
+		node->release();
+		return;
+	}
+	if(node->state.load() != TimerNode::PENDING) {
+		timer_count--;
+		node->release();
+		return;
+	}
+	fire(node);
+	//Stay on the original schedule, skipping any periods we've fallen behind by.
+	while(node->expires <= current_tick) node->expires += node->period;
+	insert(node);
+}
+
+unsigned long long TimerWheel::nextWakeTick() {
+	if(timer_count == 0) return 0;
+	//The next occupied slot of level 0, or the tick when it wraps and the level above has to be looked at.
+	unsigned long long wrap = (current_tick|(SLOTS-1))+1;
+	for(auto t = current_tick+1; t < wrap; t++) {
+		if(slots[0][t&(SLOTS-1)]) return t;
+	}
+	return wrap;
+}
+
+}
@@ -0,0 +1,38 @@
+/**This file is part of powercores, released under the terms of the Unlicense.
+See LICENSE in the root of the powercores repository for details.*/
+
+#include <powercores/barrier.hpp>
+#include <powercores/utilities.hpp>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <stdio.h>
+
+int main() {
+	printf("Testing Barrier...\n");
+	int threads = 6;
+	int rounds = 2000;
+	std::atomic<int> accum{0};
+	std::atomic<int> failed{0};
+	//Spin briefly so that both the spinning and the sleeping paths get used.
+	powercores::Barrier barrier(threads, 50);
+	std::vector<std::thread> thread_array;
+	for(int t = 0; t < threads; t++) {
+		thread_array.push_back(powercores::safeStartThread([&] () {
+			for(int r = 0; r < rounds; r++) {
+				accum.fetch_add(1);
+				barrier.arriveAndWait();
+				//Everyone has added for this round, and nobody can add for the next until we all arrive again.
+				if(accum.load() != threads*(r+1)) failed.store(1);
+				barrier.arriveAndWait();
+			}
+		}));
+	}
+	for(auto &i: thread_array) i.join();
+	if(failed.load()) {
+		printf("Barrier test failed.\n");
+		return 1;
+	}
+	printf("Barrier test passed.\n");
+	return 0;
+}
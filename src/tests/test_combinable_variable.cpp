@@ -0,0 +1,49 @@
+/**This file is part of powercores, released under the terms of the Unlicense.
+See LICENSE in the root of the powercores repository for details.*/
+
+#include <powercores/combinable_variable.hpp>
+#include <powercores/thread_pool.hpp>
+#include <powercores/utilities.hpp>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+
+int main() {
+	printf("Testing CombinableVariable...\n");
+	powercores::CombinableVariable<long long> sum;
+	powercores::ThreadPool tp{4};
+	tp.start();
+	int n = 100000;
+	tp.parallelFor(0, n, [&] (int i) {*sum += i;}, 100).get();
+	long long total = sum.combine([] (long long a, long long b) {return a+b;});
+	if(total != (long long)n*(n-1)/2) {
+		printf("CombinableVariable test failed: got %lli.\n", total);
+		return 1;
+	}
+	//No two values share a cache line.
+	std::vector<char*> addresses;
+	sum.forEach([&] (long long &v) {addresses.push_back((char*)&v);});
+	for(auto a: addresses) {
+		for(auto b: addresses) {
+			if(a != b && (a > b ? a-b : b-a) < (long)powercores::CACHE_LINE_SIZE) {
+				printf("CombinableVariable test failed: two values are within a cache line.\n");
+				return 1;
+			}
+		}
+	}
+	//Values outlive their threads.
+	auto t = powercores::safeStartThread([&] () {*sum += 1;});
+	t.join();
+	if(sum.combine([] (long long a, long long b) {return a+b;}) != total+1) {
+		printf("CombinableVariable test failed: a value was lost when its thread exited.\n");
+		return 1;
+	}
+	sum.clear();
+	if(sum.combine([] (long long a, long long b) {return a+b;}) != 0 || *sum != 0) {
+		printf("CombinableVariable test failed: clear didn't reset the values.\n");
+		return 1;
+	}
+	tp.stop();
+	printf("CombinableVariable test passed.\n");
+	return 0;
+}
@@ -0,0 +1,102 @@
+/**This file is part of powercores, released under the terms of the Unlicense.
+See LICENSE in the root of the powercores repository for details.*/
+
+#include <powercores/epoch.hpp>
+#include <powercores/thread_pool.hpp>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <mutex>
+#include <stdio.h>
+
+//Stands in for an audio graph which gets swapped out while jobs read it.
+//Instead of deleting, the test's deleter marks graphs freed and keeps them, so that a reader who sees one has caught the reclamation out.
+struct Graph {
+	int generation;
+	std::atomic<bool> freed{false};
+};
+
+std::atomic<int> freed_count{0};
+std::mutex graveyard_lock;
+std::vector<Graph*> graveyard;
+
+void freeGraph(void* p) {
+	auto g = static_cast<Graph*>(p);
+	g->freed.store(true);
+	freed_count.fetch_add(1);
+	std::lock_guard<std::mutex> l(graveyard_lock);
+	graveyard.push_back(g);
+}
+
+Graph* makeGraph(int generation) {
+	auto g = new Graph();
+	g->generation = generation;
+	return g;
+}
+
+int main() {
+	printf("Testing epoch-based reclamation...\n");
+	std::atomic<Graph*> current{makeGraph(0)};
+	int swaps = 5000;
+	std::atomic<bool> done{false};
+	std::atomic<int> bad{0};
+	powercores::ThreadPool tp{3};
+	tp.start();
+	std::vector<std::future<void>> readers;
+	for(int r = 0; r < 3; r++) {
+		readers.push_back(tp.submitJobWithResult([&] () {
+			while(done.load() == false) {
+				powercores::EpochGuard guard;
+				auto g = current.load(std::memory_order_acquire);
+				for(int i = 0; i < 20; i++) {
+					if(g->freed.load()) bad.fetch_add(1);
+				}
+			}
+		}));
+	}
+	for(int i = 1; i <= swaps; i++) {
+		auto old = current.exchange(makeGraph(i), std::memory_order_acq_rel);
+		powercores::epochRetire(old, freeGraph);
+		if(i%50 == 0) std::this_thread::yield();
+	}
+	done.store(true);
+	for(auto &r: readers) r.get();
+	if(bad.load()) {
+		printf("Epoch test failed: readers saw %i freed graphs.\n", bad.load());
+		return 1;
+	}
+	//No readers now, so one collect frees the rest.
+	powercores::epochCollect();
+	if(freed_count.load() != swaps) {
+		printf("Epoch test failed: %i of %i retired graphs were freed.\n", freed_count.load(), swaps);
+		return 1;
+	}
+	//Graphs retired from jobs are freed between later jobs on the same worker.
+	tp.setThreadCount(1);
+	freed_count.store(0);
+	tp.submitJobWithResult([] () {
+		powercores::epochRetire(makeGraph(-1), freeGraph);
+	}).get();
+	for(int i = 0; i < 3; i++) tp.submitJobWithResult([] () {}).get();
+	if(freed_count.load() != 1) {
+		printf("Epoch test failed: a graph retired by a job wasn't freed between jobs.\n");
+		return 1;
+	}
+	//An exiting thread leaves its garbage for the next collector.
+	freed_count.store(0);
+	std::thread t([] () {
+		powercores::EpochGuard guard;
+		for(int i = 0; i < 10; i++) powercores::epochRetire(makeGraph(-1), freeGraph);
+	});
+	t.join();
+	powercores::epochCollect();
+	if(freed_count.load() != 10) {
+		printf("Epoch test failed: %i of 10 graphs retired by an exiting thread were freed.\n", freed_count.load());
+		return 1;
+	}
+	tp.stop();
+	delete current.load();
+	for(auto g: graveyard) delete g;
+	printf("Epoch test passed.\n");
+	return 0;
+}
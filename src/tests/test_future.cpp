@@ -0,0 +1,94 @@
+/**This file is part of powercores, released under the terms of the Unlicense.
+See LICENSE in the root of the powercores repository for details.*/
+
+#include <powercores/future.hpp>
+#include <powercores/thread_pool.hpp>
+#include <atomic>
+#include <vector>
+#include <stdexcept>
+#include <stdio.h>
+
+int main() {
+	printf("Testing Future and Promise...\n");
+	powercores::ThreadPool tp{4};
+	tp.start();
+	//Fan out, then fan in with whenAll, without blocking until the end.
+	int jobs = 1000;
+	std::vector<powercores::Future<int>> futures;
+	for(int i = 0; i < jobs; i++) {
+		futures.push_back(tp.submitJobWithFuture([] (int x) {return x;}, i).then(tp, [] (int x) {return 2*x;}));
+	}
+	auto all = powercores::whenAll(futures);
+	auto sum = all.then([] (std::vector<int> v) {
+		long long s = 0;
+		for(auto i: v) s += i;
+		return s;
+	});
+	if(sum.get() != (long long)jobs*(jobs-1)) {
+		printf("Future test failed: whenAll of continuations got the wrong sum.\n");
+		return 1;
+	}
+	//Each bool arrives on its own thread, so they mustn't share storage until the end.
+	std::vector<powercores::Future<bool>> bools;
+	for(int i = 0; i < jobs; i++) bools.push_back(tp.submitJobWithFuture([] (int x) {return x%3 == 0;}, i));
+	auto boolResults = powercores::whenAll(bools).get();
+	for(int i = 0; i < jobs; i++) {
+		if(boolResults[i] != (i%3 == 0)) {
+			printf("Future test failed: whenAll of bools got the wrong value at %i.\n", i);
+			return 1;
+		}
+	}
+	//Exceptions skip continuations and reach the end of the chain.
+	std::atomic<int> skipped{0};
+	auto failed = tp.submitJobWithFuture([] () -> int {throw std::runtime_error("expected");}).then([&] (int x) {skipped.fetch_add(1); return x;});
+	bool threw = false;
+	try {
+		failed.get();
+	}
+	catch(std::runtime_error &) {
+		threw = true;
+	}
+	if(threw == false || skipped.load() != 0) {
+		printf("Future test failed: an exception didn't pass through a continuation.\n");
+		return 1;
+	}
+	//whenAny picks the one which is already done.
+	powercores::Promise<int> never;
+	std::vector<powercores::Future<int>> race;
+	race.push_back(never.getFuture());
+	race.push_back(tp.submitJobWithFuture([] () {return 5;}));
+	auto first = powercores::whenAny(race).get();
+	if(first.first != 1 || first.second != 5) {
+		printf("Future test failed: whenAny chose the wrong future.\n");
+		return 1;
+	}
+	never.setValue(0);
+	//Void futures, and a broken promise.
+	std::atomic<int> ran{0};
+	std::vector<powercores::Future<void>> voids;
+	for(int i = 0; i < 100; i++) voids.push_back(tp.submitJobWithFuture([&] () {ran.fetch_add(1);}));
+	powercores::whenAll(voids).get();
+	if(ran.load() != 100) {
+		printf("Future test failed: whenAll of void futures finished early.\n");
+		return 1;
+	}
+	powercores::Future<void> orphan;
+	{
+		powercores::Promise<void> p;
+		orphan = p.getFuture();
+	}
+	threw = false;
+	try {
+		orphan.get();
+	}
+	catch(std::future_error &) {
+		threw = true;
+	}
+	if(threw == false) {
+		printf("Future test failed: destroying a promise didn't break it.\n");
+		return 1;
+	}
+	tp.stop();
+	printf("Future test passed.\n");
+	return 0;
+}
@@ -0,0 +1,81 @@
+/**This file is part of powercores, released under the terms of the Unlicense.
+See LICENSE in the root of the powercores repository for details.*/
+
+#include <powercores/lock_free_queue.hpp>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <stdio.h>
+
+int main() {
+	printf("Testing lock-free queue...\n");
+	powercores::LockFreeQueue<int> q(100);
+	if(q.capacity() != 128) {
+		printf("Capacity was not rounded up to a power of two.\n");
+		return 1;
+	}
+	int out;
+	if(q.tryDequeue(out)) {
+		printf("Dequeued from an empty queue.\n");
+		return 1;
+	}
+	for(int i = 0; i < 128; i++) {
+		if(q.tryEnqueue(i) == false) {
+			printf("Failed to enqueue before the queue was full.\n");
+			return 1;
+		}
+	}
+	if(q.tryEnqueue(128)) {
+		printf("Enqueued into a full queue.\n");
+		return 1;
+	}
+	for(int i = 0; i < 128; i++) {
+		if(q.tryDequeue(out) == false || out != i) {
+			printf("Single-threaded order test failed.\n");
+			return 1;
+		}
+	}
+	//Ranges, wrapping around the end of the buffer.
+	std::vector<int> in(100), got(100);
+	for(int i = 0; i < 100; i++) in[i] = i;
+	if(q.tryEnqueueRange(in.begin(), in.end()) != 100 || q.tryEnqueueRange(in.begin(), in.end()) != 28) {
+		printf("Range enqueue test failed.\n");
+		return 1;
+	}
+	if(q.tryDequeueRange(100, got.begin()) != 100 || got != in || q.size() != 28) {
+		printf("Range dequeue test failed.\n");
+		return 1;
+	}
+	while(q.tryDequeue(out));
+	//Many producers and consumers.
+	powercores::LockFreeQueue<int> q2(64);
+	int threads = 4;
+	int perThread = 100000;
+	std::atomic<long long> accum{0};
+	std::atomic<int> consumed{0};
+	std::vector<std::thread> thread_array;
+	for(int t = 0; t < threads; t++) {
+		thread_array.emplace_back([&] () {
+			for(int i = 1; i <= perThread; i++) {
+				while(q2.tryEnqueue(i) == false) std::this_thread::yield();
+			}
+		});
+		thread_array.emplace_back([&] () {
+			int buffer[8];
+			while(consumed.load() < threads*perThread) {
+				int n = q2.tryDequeueRange(8, buffer);
+				if(n == 0) std::this_thread::yield();
+				for(int i = 0; i < n; i++) accum.fetch_add(buffer[i]);
+				consumed.fetch_add(n);
+			}
+		});
+	}
+	for(auto &i: thread_array) i.join();
+	long long expected = (long long)threads*perThread*(perThread+1)/2;
+	if(accum.load() != expected) {
+		printf("Thread safety test failed.\n");
+		return 1;
+	}
+	printf("Lock-free queue test passed.\n");
+	return 0;
+}
@@ -0,0 +1,91 @@
+/**This file is part of powercores, released under the terms of the Unlicense.
+See LICENSE in the root of the powercores repository for details.*/
+
+#include <powercores/pool_allocator.hpp>
+#include <powercores/utilities.hpp>
+#include <thread>
+#include <vector>
+#include <set>
+#include <atomic>
+#include <string.h>
+#include <stdio.h>
+
+int main() {
+	printf("Testing the pool allocator...\n");
+	//Blocks freed on the allocating thread are reused straight away.
+	void* a = powercores::poolAllocate(40);
+	powercores::poolFree(a);
+	if(powercores::poolAllocate(48) != a) {
+		printf("Pool allocator test failed: a freed block wasn't reused.\n");
+		return 1;
+	}
+	powercores::poolFree(a);
+	//Blocks freed on another thread come back to their owner.
+	std::vector<void*> blocks;
+	for(int i = 0; i < 100; i++) {
+		blocks.push_back(powercores::poolAllocate(100));
+		memset(blocks.back(), i, 100);
+	}
+	std::set<void*> original(blocks.begin(), blocks.end());
+	auto freer = powercores::safeStartThread([&] () {
+		for(auto b: blocks) powercores::poolFree(b);
+	});
+	freer.join();
+	for(int i = 0; i < 100; i++) {
+		blocks[i] = powercores::poolAllocate(100);
+		if(original.count(blocks[i]) == 0) {
+			printf("Pool allocator test failed: blocks freed on another thread weren't returned.\n");
+			return 1;
+		}
+	}
+	for(auto b: blocks) powercores::poolFree(b);
+	//A thread which keeps running hands blocks back in batches, without waiting to exit.
+	//A size nothing above used, so that our own freelist for it is empty and allocating must pick up the batch.
+	blocks.clear();
+	for(int i = 0; i < 32; i++) blocks.push_back(powercores::poolAllocate(600));
+	original = std::set<void*>(blocks.begin(), blocks.end());
+	std::atomic<bool> freed{false}, checked{false};
+	auto liveFreer = powercores::safeStartThread([&] () {
+		for(auto b: blocks) powercores::poolFree(b);
+		freed.store(true);
+		while(checked.load() == false) std::this_thread::yield();
+	});
+	while(freed.load() == false) std::this_thread::yield();
+	int returned = 0;
+	for(int i = 0; i < 32; i++) {
+		blocks[i] = powercores::poolAllocate(600);
+		returned += (int)original.count(blocks[i]);
+	}
+	checked.store(true);
+	liveFreer.join();
+	for(auto b: blocks) powercores::poolFree(b);
+	if(returned != 32) {
+		printf("Pool allocator test failed: only %i of a batch of 32 blocks freed on a running thread came back.\n", returned);
+		return 1;
+	}
+	//Blocks outlive the thread which allocated them.
+	std::vector<int*> orphans;
+	auto allocator = powercores::safeStartThread([&] () {
+		for(int i = 0; i < 100; i++) orphans.push_back(powercores::poolNew<int>(i));
+	});
+	allocator.join();
+	for(int i = 0; i < 100; i++) {
+		if(*orphans[i] != i) {
+			printf("Pool allocator test failed: a block changed after its thread exited.\n");
+			return 1;
+		}
+		powercores::poolDelete(orphans[i]);
+	}
+	//Large blocks, and containers.
+	void* big = powercores::poolAllocate(100000);
+	memset(big, 0, 100000);
+	powercores::poolFree(big);
+	std::vector<double, powercores::PoolAllocator<double>> scratch;
+	for(int i = 0; i < 10000; i++) scratch.push_back(i);
+	if(scratch[9999] != 9999) {
+		printf("Pool allocator test failed: vector contents are wrong.\n");
+		return 1;
+	}
+	printf("Pool allocator test passed.\n");
+	return 0;
+}
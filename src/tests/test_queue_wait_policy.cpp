@@ -0,0 +1,66 @@
+/**This file is part of powercores, released under the terms of the Unlicense.
+See LICENSE in the root of the powercores repository for details.*/
+
+#include <powercores/threadsafe_queue.hpp>
+#include <powercores/thread_pool.hpp>
+#include <powercores/wait_policy.hpp>
+#include <powercores/utilities.hpp>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <stdio.h>
+
+int main() {
+	printf("Testing wait policies...\n");
+	powercores::ThreadsafeQueue<int> q;
+	q.setWaitPolicy(powercores::WaitPolicy(5000, 10));
+	int count = 20000;
+	long long sum = 0;
+	auto consumer = powercores::safeStartThread([&] () {
+		for(int i = 0; i < count; i++) sum += q.dequeue();
+	});
+	for(int i = 0; i < count; i++) {
+		q.enqueue(i);
+		//Now and then, give the consumer time to go to sleep.
+		if(i%1000 == 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	consumer.join();
+	if(sum != (long long)count*(count-1)/2) {
+		printf("Wait policy test failed: the spinning consumer lost items.\n");
+		return 1;
+	}
+	//enqueueRange must wake a sleeping reader.
+	q.setWaitPolicy(powercores::WaitPolicy());
+	int got[3] = {0};
+	auto reader = powercores::safeStartThread([&] () {q.dequeueRange(3, got);});
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	int items[] = {1, 2, 3};
+	q.enqueueRange(items, items+3);
+	reader.join();
+	if(got[0] == 0) {
+		printf("Wait policy test failed: enqueueRange didn't wake the reader.\n");
+		return 1;
+	}
+	for(int stealing = 0; stealing < 2; stealing++) {
+		for(int spin = 0; spin < 2; spin++) {
+			powercores::ThreadPool tp{3};
+			tp.setWorkStealing(stealing == 1);
+			tp.setWaitPolicy(spin ? powercores::WaitPolicy(20000, 100) : powercores::WaitPolicy());
+			tp.start();
+			std::atomic<int> ran{0};
+			for(int i = 0; i < 1000; i++) {
+				tp.submitJob([&] () {ran.fetch_add(1);});
+				if(i%100 == 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+			tp.submitBarrier();
+			tp.submitJobWithResult([] () {}).get();
+			if(ran.load() != 1000) {
+				printf("Wait policy test failed: the pool lost jobs.\n");
+				return 1;
+			}
+			tp.stop();
+		}
+	}
+	printf("Wait policy test passed.\n");
+	return 0;
+}
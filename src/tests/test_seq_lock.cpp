@@ -0,0 +1,63 @@
+/**This file is part of powercores, released under the terms of the Unlicense.
+See LICENSE in the root of the powercores repository for details.*/
+
+#include <powercores/seq_lock.hpp>
+#include <powercores/thread_pool.hpp>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <stdio.h>
+
+//Big enough that copying it isn't atomic.  Every element is the same in any value the writer publishes.
+struct Coefficients {
+	int values[256];
+};
+
+int main() {
+	printf("Testing SeqLock...\n");
+	Coefficients initial;
+	for(auto &i: initial.values) i = 0;
+	powercores::SeqLock<Coefficients> published(initial);
+	int writes = 20000;
+	std::atomic<bool> done{false};
+	std::atomic<int> torn{0}, backwards{0};
+	//Readers are pool jobs, as they would be in an audio pool.
+	powercores::ThreadPool tp{3};
+	tp.start();
+	std::vector<std::future<void>> readers;
+	for(int r = 0; r < 3; r++) {
+		readers.push_back(tp.submitJobWithResult([&] () {
+			Coefficients c;
+			unsigned long long seen = 0;
+			int last = 0;
+			while(done.load() == false) {
+				if(published.readIfNewer(c, seen) == false) {
+					std::this_thread::yield();
+					continue;
+				}
+				for(auto i: c.values) if(i != c.values[0]) torn.fetch_add(1);
+				if(c.values[0] < last) backwards.fetch_add(1);
+				last = c.values[0];
+			}
+		}));
+	}
+	Coefficients c;
+	for(int w = 1; w <= writes; w++) {
+		for(auto &i: c.values) i = w;
+		published.write(c);
+		if(w%100 == 0) std::this_thread::yield();
+	}
+	done.store(true);
+	for(auto &r: readers) r.get();
+	tp.stop();
+	if(torn.load() || backwards.load()) {
+		printf("SeqLock test failed: %i torn reads, %i reads went backwards.\n", torn.load(), backwards.load());
+		return 1;
+	}
+	if(published.read().values[255] != writes || published.getVersion() != (unsigned long long)writes) {
+		printf("SeqLock test failed: the last write wasn't visible.\n");
+		return 1;
+	}
+	printf("SeqLock test passed.\n");
+	return 0;
+}
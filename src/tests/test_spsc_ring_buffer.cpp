@@ -0,0 +1,84 @@
+/**This file is part of powercores, released under the terms of the Unlicense.
+See LICENSE in the root of the powercores repository for details.*/
+
+#include <powercores/spsc_ring_buffer.hpp>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <stdio.h>
+
+int main() {
+	printf("Testing single-producer single-consumer ring buffer...\n");
+	powercores::SpscRingBuffer<float> rb(1000);
+	if(rb.capacity() != 1024 || rb.writeAvailable() != 1024 || rb.readAvailable() != 0) {
+		printf("Ring buffer started in the wrong state.\n");
+		return 1;
+	}
+	int blocks = 20000;
+	int blockSize = 96; //Doesn't divide the capacity, so blocks wrap.
+	std::atomic<int> failed{0};
+	std::thread writer([&] () {
+		std::vector<float> block(blockSize);
+		float next = 0;
+		for(int b = 0; b < blocks; b++) {
+			for(auto &i: block) i = next++;
+			//Alternate between copying and writing in place.
+			if(b%2) {
+				unsigned int done = 0;
+				while(done < block.size()) {
+					unsigned int got = rb.write(block.data()+done, block.size()-done);
+					if(got == 0) std::this_thread::yield();
+					done += got;
+				}
+			}
+			else {
+				unsigned int done = 0;
+				while(done < block.size()) {
+					auto r = rb.beginWrite(block.size()-done);
+					for(unsigned int i = 0; i < r.first_size; i++) r.first[i] = block[done+i];
+					for(unsigned int i = 0; i < r.second_size; i++) r.second[i] = block[done+r.first_size+i];
+					rb.endWrite(r.size());
+					done += r.size();
+					if(r.size() == 0) std::this_thread::yield();
+				}
+			}
+		}
+	});
+	std::thread reader([&] () {
+		std::vector<float> block(blockSize);
+		float expected = 0;
+		for(int b = 0; b < blocks; b++) {
+			unsigned int done = 0;
+			if(b%2) {
+				while(done < block.size()) {
+					unsigned int got = rb.read(block.data()+done, block.size()-done);
+					if(got == 0) std::this_thread::yield();
+					done += got;
+				}
+			}
+			else {
+				while(done < block.size()) {
+					auto r = rb.beginRead(block.size()-done);
+					for(unsigned int i = 0; i < r.first_size; i++) block[done+i] = r.first[i];
+					for(unsigned int i = 0; i < r.second_size; i++) block[done+r.first_size+i] = r.second[i];
+					rb.endRead(r.size());
+					done += r.size();
+					if(r.size() == 0) std::this_thread::yield();
+				}
+			}
+			for(auto i: block) {
+				if(i != expected) failed.store(1);
+				expected++;
+			}
+		}
+	});
+	writer.join();
+	reader.join();
+	float f;
+	if(failed.load() || rb.tryRead(f)) {
+		printf("Ring buffer test failed.\n");
+		return 1;
+	}
+	printf("Ring buffer test passed.\n");
+	return 0;
+}
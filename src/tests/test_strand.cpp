@@ -0,0 +1,67 @@
+/**This file is part of powercores, released under the terms of the Unlicense.
+See LICENSE in the root of the powercores repository for details.*/
+
+#include <powercores/strand.hpp>
+#include <powercores/thread_pool.hpp>
+#include <powercores/utilities.hpp>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <stdio.h>
+
+//Each strand's state is plain ints, so overlapping jobs would lose updates.
+class StreamState {
+	public:
+	int count = 0;
+	int last[2] = {-1, -1};
+	bool in_order = true;
+	std::atomic<int> running{0};
+	bool overlapped = false;
+};
+
+int main() {
+	printf("Testing Strand...\n");
+	powercores::ThreadPool tp{4};
+	tp.setWorkStealing(true);
+	tp.start();
+	int strandCount = 16, perProducer = 2000;
+	std::vector<std::unique_ptr<powercores::Strand>> strands;
+	std::vector<StreamState> states(strandCount);
+	for(int i = 0; i < strandCount; i++) strands.emplace_back(new powercores::Strand(tp));
+	std::vector<std::thread> producers;
+	for(int p = 0; p < 2; p++) {
+		producers.push_back(powercores::safeStartThread([&, p] () {
+			for(int i = 0; i < perProducer; i++) {
+				for(int s = 0; s < strandCount; s++) {
+					auto state = &states[s];
+					strands[s]->submitJob([state, p, i] () {
+						if(state->running.fetch_add(1) != 0) state->overlapped = true;
+						if(state->last[p] != i-1) state->in_order = false;
+						state->last[p] = i;
+						state->count++;
+						state->running.fetch_sub(1);
+					});
+				}
+			}
+		}));
+	}
+	for(auto &t: producers) t.join();
+	auto last = strands[0]->submitJobWithFuture([&] () {return states[0].count;});
+	tp.waitFor(last);
+	if(last.get() != 2*perProducer) {
+		printf("Strand test failed: a future from a strand didn't see the jobs before it.\n");
+		return 1;
+	}
+	//Destroying a strand waits for its jobs.
+	strands.clear();
+	for(int s = 0; s < strandCount; s++) {
+		if(states[s].overlapped || states[s].in_order == false || states[s].count != 2*perProducer) {
+			printf("Strand test failed: strand %i ran %i jobs, overlapped %i, in order %i.\n", s, states[s].count, (int)states[s].overlapped, (int)states[s].in_order);
+			return 1;
+		}
+	}
+	tp.stop();
+	printf("Strand test passed.\n");
+	return 0;
+}
@@ -0,0 +1,86 @@
+/**This file is part of powercores, released under the terms of the Unlicense.
+See LICENSE in the root of the powercores repository for details.*/
+
+#include <powercores/task.hpp>
+#include <powercores/thread_pool.hpp>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <cstdlib>
+#include <stdio.h>
+
+//Count every allocation, so we can check that small tasks never make one.
+std::atomic<int> allocations{0};
+
+void* operator new(std::size_t size) {
+	allocations.fetch_add(1);
+	void* ret = std::malloc(size ? size : 1);
+	if(ret == nullptr) throw std::bad_alloc();
+	return ret;
+}
+
+void operator delete(void* p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+	std::free(p);
+}
+
+int main() {
+	printf("Testing Task...\n");
+	int counter = 0;
+	int before = allocations.load();
+	{
+		void* a = &counter, *b = &counter, *c = &counter;
+		powercores::Task t([&counter, a, b, c] () {counter += a == b && b == c;});
+		powercores::Task t2(std::move(t));
+		powercores::Task t3;
+		t3 = std::move(t2);
+		if(t || t2 || t3.isInline() == false) {
+			printf("Task was not moved correctly.\n");
+			return 1;
+		}
+		t3();
+	}
+	if(allocations.load() != before || counter != 1) {
+		printf("A small task allocated.\n");
+		return 1;
+	}
+	//Too big for the inline buffer, so it goes to the heap.
+	char big[powercores::Task::INLINE_SIZE+1] = {0};
+	powercores::Task bigTask([&counter, big] () {counter += big[0]+1;});
+	if(bigTask.isInline()) {
+		printf("A large task was stored inline.\n");
+		return 1;
+	}
+	powercores::Task movedBig(std::move(bigTask));
+	movedBig();
+	//Move-only callables, and destruction exactly once.
+	auto shared = std::make_shared<int>(5);
+	{
+		std::unique_ptr<int> p(new int(3));
+		powercores::Task t([p = std::move(p), shared] () {*shared += *p;});
+		powercores::Task t2(std::move(t));
+		t2();
+	}
+	if(counter != 2 || *shared != 8 || shared.use_count() != 1) {
+		printf("Task failed to run or destroy its callable.\n");
+		return 1;
+	}
+	//Move-only jobs through the pool.
+	powercores::ThreadPool tp{2};
+	tp.start();
+	std::unique_ptr<int> p(new int(7));
+	auto f = tp.submitJobWithResult([] (int x) {return x;}, 1);
+	std::atomic<int> result{0};
+	tp.submitJob([p = std::move(p), &result] () {result.store(*p);});
+	f.get();
+	tp.stop();
+	if(result.load() != 7) {
+		printf("Move-only job failed.\n");
+		return 1;
+	}
+	printf("Task test passed.\n");
+	return 0;
+}
@@ -0,0 +1,84 @@
+/**This file is part of powercores, released under the terms of the Unlicense.
+See LICENSE in the root of the powercores repository for details.*/
+
+#include <powercores/task_graph.hpp>
+#include <powercores/thread_pool.hpp>
+#include <powercores/exceptions.hpp>
+#include <atomic>
+#include <vector>
+#include <stdexcept>
+#include <stdio.h>
+
+int main() {
+	printf("Testing TaskGraph...\n");
+	powercores::ThreadPool tp{4};
+	tp.start();
+	//A layered graph: every node in a layer depends on two nodes of the previous one.
+	//Each node records a timestamp, and checks that its predecessors' are earlier.
+	int layers = 6, width = 8;
+	std::atomic<int> clock{0};
+	std::vector<std::atomic<int>> stamps(layers*width);
+	std::atomic<int> failures{0};
+	powercores::TaskGraph graph;
+	for(int l = 0; l < layers; l++) {
+		for(int w = 0; w < width; w++) {
+			graph.addNode([&, l, w] () {
+				if(l > 0) {
+					int a = stamps[(l-1)*width+w].load(), b = stamps[(l-1)*width+(w+1)%width].load();
+					if(a == 0 || b == 0) failures.fetch_add(1);
+				}
+				stamps[l*width+w].store(clock.fetch_add(1)+1);
+			});
+			if(l > 0) {
+				graph.addEdge((l-1)*width+w, l*width+w);
+				graph.addEdge((l-1)*width+(w+1)%width, l*width+w);
+			}
+		}
+	}
+	graph.compile();
+	for(int run = 0; run < 1000; run++) {
+		for(auto &s: stamps) s.store(0);
+		graph.run(tp);
+		for(auto &s: stamps) if(s.load() == 0) failures.fetch_add(1);
+	}
+	if(failures.load()) {
+		printf("TaskGraph ran a node too early or not at all.\n");
+		return 1;
+	}
+	//Cycles are rejected.
+	powercores::TaskGraph cyclic;
+	int a = cyclic.addNode([] () {}), b = cyclic.addNode([] () {});
+	cyclic.addEdge(a, b);
+	cyclic.addEdge(b, a);
+	bool threw = false;
+	try {
+		cyclic.compile();
+	}
+	catch(powercores::CycleException &e) {
+		threw = true;
+	}
+	if(threw == false) {
+		printf("TaskGraph accepted a cycle.\n");
+		return 1;
+	}
+	//Exceptions skip the rest of the graph and come back out of run.
+	powercores::TaskGraph failing;
+	bool ranAfter = false;
+	int first = failing.addNode([] () {throw std::runtime_error("expected");});
+	int second = failing.addNode([&] () {ranAfter = true;});
+	failing.addEdge(first, second);
+	threw = false;
+	try {
+		failing.run(tp);
+	}
+	catch(std::runtime_error &e) {
+		threw = true;
+	}
+	if(threw == false || ranAfter) {
+		printf("TaskGraph did not handle an exception.\n");
+		return 1;
+	}
+	tp.stop();
+	printf("TaskGraph test passed.\n");
+	return 0;
+}
@@ -0,0 +1,56 @@
+/**This file is part of powercores, released under the terms of the Unlicense.
+See LICENSE in the root of the powercores repository for details.*/
+#include <powercores/utilities.hpp>
+#include <powercores/thread_local_variable.hpp>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <stdio.h>
+
+//Global, since the main thread's values are deleted after main returns.
+std::atomic<int> created{0}, deleted{0};
+
+int* creator() {
+	created.fetch_add(1);
+	return new int(0);
+}
+
+void deleter(int* i) {
+	deleted.fetch_add(1);
+	delete i;
+}
+
+int main() {
+	int count = 50;
+	std::vector<std::thread> threads;
+	{
+		powercores::ThreadLocalVariable<int> v(creator, deleter);
+		for(int i = 0; i < count; i++) {
+			threads.push_back(powercores::safeStartThread([&] () {
+				for(int j = 0; j < 10; j++) *v += 1;
+			}));
+		}
+		for(auto &i: threads) i.join();
+		threads.clear();
+	}
+	if(created.load() != count || deleted.load() != count) {
+		printf("Values were not created once and deleted at thread exit once per thread.\n");
+		return 1;
+	}
+	//A new variable which reuses a dead one's slot must not see its value.
+	int failed = 0;
+	{
+		auto first = new powercores::ThreadLocalVariable<int>(creator, deleter);
+		**first = 5;
+		delete first;
+		powercores::ThreadLocalVariable<int> second(creator, deleter);
+		if(*second != 0) failed = 1;
+		//The stale value was deleted when second replaced it.
+		if(deleted.load() != count+1) failed = 1;
+	}
+	if(failed) {
+		printf("A variable saw a dead variable's value.\n");
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,91 @@
+/**This file is part of powercores, released under the terms of the Unlicense.
+See LICENSE in the root of the powercores repository for details.*/
+
+#include <powercores/thread_placement.hpp>
+#include <powercores/thread_pool.hpp>
+#include <algorithm>
+#include <vector>
+#include <stdio.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+int main() {
+	printf("Testing thread placement...\n");
+	auto topology = powercores::CpuTopology::detect();
+	if(topology.cpus.empty()) {
+		printf("Thread placement test failed: no CPUs detected.\n");
+		return 1;
+	}
+	auto order = topology.spreadOrder();
+	std::vector<int> ids;
+	for(auto &i: topology.cpus) ids.push_back(i.id);
+	std::sort(ids.begin(), ids.end());
+	auto sortedOrder = order;
+	std::sort(sortedOrder.begin(), sortedOrder.end());
+	if(sortedOrder != ids) {
+		printf("Thread placement test failed: the spread order isn't a permutation of the CPUs.\n");
+		return 1;
+	}
+	//Two packages of two cores with two hyperthreads each, numbered the way Linux usually numbers them.
+	powercores::CpuTopology fake;
+	for(int i = 0; i < 8; i++) {
+		powercores::CpuInfo info;
+		info.id = i;
+		info.package = (i/2)%2;
+		info.core = i%2;
+		fake.cpus.push_back(info);
+	}
+	//Cores: (0,0)={0,4} (0,1)={1,5} (1,0)={2,6} (1,1)={3,7}
+	std::vector<int> expected = {0, 2, 1, 3, 4, 6, 5, 7};
+	if(fake.spreadOrder() != expected) {
+		printf("Thread placement test failed: the spread order doesn't alternate packages and fill cores before hyperthreads.\n");
+		return 1;
+	}
+	powercores::ThreadPool tp{4};
+	tp.setWorkerAffinity(powercores::WorkerAffinity::SPREAD);
+	//Raising our own nice value is always allowed.
+	tp.setWorkerScheduling(powercores::ThreadScheduling::NICE, 5);
+	tp.start();
+	auto stats = tp.getStats();
+	for(int i = 0; i < 4; i++) {
+		auto &w = stats.workers[i];
+#ifdef __linux__
+		if(w.cpu != order[i%order.size()] || w.scheduling_applied == false) {
+			printf("Thread placement test failed: worker %i is on CPU %i, expected %i.\n", i, w.cpu, order[i%order.size()]);
+			return 1;
+		}
+#endif
+	}
+	//Every job must run where its worker was pinned.
+	std::vector<int> pinnedTo;
+	for(auto &w: stats.workers) if(w.cpu != -1) pinnedTo.push_back(w.cpu);
+	for(int i = 0; i < 100; i++) {
+		int cpu = tp.submitJobWithResult([] () {
+#ifdef __linux__
+			return sched_getcpu();
+#else
+			return -1;
+#endif
+		}).get();
+		if(cpu != -1 && pinnedTo.size() == 4 && std::find(pinnedTo.begin(), pinnedTo.end(), cpu) == pinnedTo.end()) {
+			printf("Thread placement test failed: a job ran on CPU %i, where no worker is pinned.\n", cpu);
+			return 1;
+		}
+	}
+	tp.stop();
+	tp.setWorkerAffinity(powercores::WorkerAffinity::CPUS, {0});
+	tp.start();
+	stats = tp.getStats();
+	for(auto &w: stats.workers) {
+#ifdef __linux__
+		if(w.cpu != 0) {
+			printf("Thread placement test failed: a worker wasn't pinned to CPU 0.\n");
+			return 1;
+		}
+#endif
+	}
+	tp.stop();
+	printf("Thread placement test passed.\n");
+	return 0;
+}
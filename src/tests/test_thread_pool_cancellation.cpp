@@ -0,0 +1,105 @@
+/**This file is part of powercores, released under the terms of the Unlicense.
+See LICENSE in the root of the powercores repository for details.*/
+
+#include <powercores/thread_pool.hpp>
+#include <powercores/cancellation.hpp>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <stdexcept>
+#include <stdio.h>
+
+int main() {
+	printf("Testing cancellation and exceptions...\n");
+	powercores::ThreadPool tp{1};
+	std::atomic<int> handled{0};
+	tp.setExceptionHandler([&] (std::exception_ptr e) {
+		try {
+			std::rethrow_exception(e);
+		}
+		catch(std::runtime_error &) {
+			handled.fetch_add(1);
+		}
+	});
+	tp.start();
+	//Throwing jobs don't kill the worker.
+	for(int i = 0; i < 100; i++) tp.submitJob([] () {throw std::runtime_error("expected");});
+	auto after = tp.submitJobWithFuture([] () {return 1;});
+	if(after.get() != 1 || handled.load() != 100) {
+		printf("Cancellation test failed: %i of 100 exceptions reached the handler.\n", handled.load());
+		return 1;
+	}
+	//Replacing the handler while the pool runs doesn't restart it, so pending timers keep firing.
+	std::atomic<int> ticks{0}, replaced{0};
+	auto periodic = tp.submitPeriodicJob(std::chrono::milliseconds(5), [&] () {ticks.fetch_add(1);});
+	tp.setExceptionHandler([&] (std::exception_ptr) {replaced.fetch_add(1);});
+	tp.submitJob([] () {throw std::runtime_error("expected");});
+	tp.submitJobWithFuture([] () {return 1;}).get();
+	int ticksBefore = ticks.load();
+	for(int i = 0; i < 200 && ticks.load() == ticksBefore; i++) std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	periodic.cancel();
+	if(replaced.load() != 1 || handled.load() != 100 || ticks.load() == ticksBefore) {
+		printf("Cancellation test failed: replacing the exception handler lost a timer or sent an exception to the wrong handler.\n");
+		return 1;
+	}
+	//Jobs still queued when their token is cancelled never run.  The first job holds the only worker until we've cancelled.
+	powercores::CancellationSource source;
+	std::atomic<bool> gate{false};
+	std::atomic<int> ran{0};
+	tp.submitJob([&] () {while(gate.load() == false) std::this_thread::yield();});
+	for(int i = 0; i < 100; i++) tp.submitJob(source.getToken(), [&] () {ran.fetch_add(1);});
+	auto stale = tp.submitJobWithFuture(source.getToken(), [] () {return 5;});
+	source.cancel();
+	gate.store(true);
+	bool threw = false;
+	try {
+		stale.get();
+	}
+	catch(powercores::JobCancelledException &) {
+		threw = true;
+	}
+	if(ran.load() != 0 || threw == false) {
+		printf("Cancellation test failed: %i cancelled jobs ran.\n", ran.load());
+		return 1;
+	}
+	//A running job sees its token.
+	powercores::CancellationSource running;
+	std::atomic<bool> started{false};
+	auto loop = tp.submitJobWithFuture(running.getToken(), [&] () {
+		started.store(true);
+		int spins = 0;
+		while(powercores::CancellationToken::current().isCancelled() == false) {
+			spins++;
+			std::this_thread::yield();
+		}
+		return spins;
+	});
+	while(started.load() == false) std::this_thread::yield();
+	running.cancel();
+	loop.get();
+	//parallelFor stops handing out indices.
+	powercores::CancellationSource batch;
+	std::atomic<int> indices{0};
+	auto pf = tp.parallelFor(batch.getToken(), 0, 100000, [&] (int) {
+		if(indices.fetch_add(1) == 10) batch.cancel();
+	}, 10);
+	threw = false;
+	try {
+		pf.get();
+	}
+	catch(powercores::JobCancelledException &) {
+		threw = true;
+	}
+	if(threw == false || indices.load() >= 100000) {
+		printf("Cancellation test failed: parallelFor ran %i indices after being cancelled.\n", indices.load());
+		return 1;
+	}
+	tp.stop();
+	//100 for the first handler and 1 for its replacement.
+	if(tp.getStats().workers[0].exceptions != 101) {
+		printf("Cancellation test failed: stats counted %llu exceptions.\n", tp.getStats().workers[0].exceptions);
+		return 1;
+	}
+	printf("Cancellation test passed.\n");
+	return 0;
+}
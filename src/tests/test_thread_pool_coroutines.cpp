@@ -0,0 +1,84 @@
+/**This file is part of powercores, released under the terms of the Unlicense.
+See LICENSE in the root of the powercores repository for details.*/
+
+#include <powercores/coroutines.hpp>
+#include <stdio.h>
+
+#ifndef POWERCORES_HAS_COROUTINES
+int main() {
+	printf("Coroutines aren't supported by this compiler; skipping.\n");
+	return 0;
+}
+#else
+#include <powercores/thread_pool.hpp>
+#include <atomic>
+#include <vector>
+#include <future>
+#include <stdexcept>
+
+std::atomic<int> accum{0};
+
+powercores::CoroutineTask<int> square(powercores::ThreadPool &pool, int x) {
+	co_return co_await powercores::awaitJob(pool, [x] () {return x*x;});
+}
+
+//One stream: a chain of jobs, each awaited without holding a thread.
+powercores::CoroutineTask<long long> stream(powercores::ThreadPool &pool, int id) {
+	co_await powercores::scheduleOn(pool);
+	long long sum = 0;
+	for(int i = 0; i < 20; i++) sum += co_await square(pool, id+i);
+	co_await powercores::awaitJob(pool, [] () {accum.fetch_add(1);});
+	co_return sum;
+}
+
+powercores::CoroutineTask<void> fails(powercores::ThreadPool &pool) {
+	co_await powercores::awaitJob(pool, [] () -> int {throw std::runtime_error("expected");});
+}
+
+powercores::CoroutineTask<int> barrierCheck(powercores::ThreadPool &pool) {
+	std::atomic<int> done{0};
+	for(int i = 0; i < 100; i++) pool.submitJob([&] () {done.fetch_add(1);});
+	co_await powercores::awaitBarrier(pool);
+	co_return done.load();
+}
+
+int main() {
+	printf("Testing coroutines...\n");
+	//Far more streams than threads, which only works if suspended streams don't hold a thread.
+	powercores::ThreadPool tp{2};
+	tp.start();
+	int streams = 200;
+	std::vector<std::future<long long>> results;
+	for(int s = 0; s < streams; s++) results.push_back(powercores::spawn(tp, stream(tp, s)));
+	for(int s = 0; s < streams; s++) {
+		long long expected = 0;
+		for(int i = 0; i < 20; i++) expected += (long long)(s+i)*(s+i);
+		if(results[s].get() != expected) {
+			printf("Coroutine test failed: stream %i got the wrong answer.\n", s);
+			return 1;
+		}
+	}
+	if(accum.load() != streams) {
+		printf("Coroutine test failed: only %i streams finished.\n", accum.load());
+		return 1;
+	}
+	bool threw = false;
+	try {
+		powercores::spawn(tp, fails(tp)).get();
+	}
+	catch(std::runtime_error &) {
+		threw = true;
+	}
+	if(threw == false) {
+		printf("Coroutine test failed: an exception from a job didn't reach the coroutine.\n");
+		return 1;
+	}
+	if(powercores::spawn(tp, barrierCheck(tp)).get() != 100) {
+		printf("Coroutine test failed: awaiting a barrier resumed too early.\n");
+		return 1;
+	}
+	tp.stop();
+	printf("Coroutine test passed.\n");
+	return 0;
+}
+#endif
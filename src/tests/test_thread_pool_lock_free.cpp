@@ -0,0 +1,37 @@
+/**This file is part of powercores, released under the terms of the Unlicense.
+See LICENSE in the root of the powercores repository for details.*/
+
+#include <powercores/thread_pool.hpp>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+
+int main() {
+	printf("Testing the lock-free job queue backend...\n");
+	powercores::ThreadPool tp{4};
+	tp.setJobQueueBackend(powercores::JobQueueBackend::LOCK_FREE, 256);
+	for(int stealing = 0; stealing < 2; stealing++) {
+		tp.setWorkStealing(stealing == 1);
+		tp.start();
+		int jobs = 200000;
+		std::atomic<int> accum{0};
+		for(int i = 0; i < jobs; i++) tp.submitJob([&] () {accum.fetch_add(1);});
+		for(int iteration = 0; iteration < 100; iteration++) {
+			for(int i = 0; i < 20; i++) tp.submitJob([&] () {
+				std::this_thread::sleep_for(std::chrono::microseconds(100));
+				accum.fetch_add(1);
+			});
+			int before = jobs+(iteration+1)*20;
+			tp.submitBarrier();
+			auto f = tp.submitJobWithResult([&] () {return accum.load();});
+			if(f.get() != before) {
+				printf("Lock-free backend failed: a job crossed a barrier.\n");
+				return 1;
+			}
+		}
+		tp.stop();
+	}
+	printf("Lock-free backend test passed.\n");
+	return 0;
+}
@@ -0,0 +1,55 @@
+/**This file is part of powercores, released under the terms of the Unlicense.
+See LICENSE in the root of the powercores repository for details.*/
+
+#include <powercores/thread_pool.hpp>
+#include <powercores/utilities.hpp>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <stdio.h>
+
+int main() {
+	printf("Testing submission from many threads...\n");
+	int workers = 4, producers = 4, perProducer = 10000;
+	{
+		powercores::ThreadPool tp{workers};
+		tp.start();
+		std::atomic<int> done{0};
+		std::vector<std::thread> threads;
+		for(int p = 0; p < producers; p++) {
+			threads.push_back(powercores::safeStartThread([&] () {
+				for(int i = 0; i < perProducer; i++) tp.submitJob([&] () {done.fetch_add(1, std::memory_order_relaxed);});
+			}));
+		}
+		for(auto &t: threads) t.join();
+		tp.stop();
+		if(done.load() != producers*perProducer) {
+			printf("Multi-producer test failed: %i of %i jobs ran.\n", done.load(), producers*perProducer);
+			return 1;
+		}
+		//Without stealing, workers run exactly what they were dealt, and every producer deals evenly.
+		auto stats = tp.getStats();
+		for(int w = 0; w < workers; w++) {
+			if(stats.workers[w].jobs_executed != (unsigned long long)producers*perProducer/workers) {
+				printf("Multi-producer test failed: worker %i ran %llu jobs.\n", w, stats.workers[w].jobs_executed);
+				return 1;
+			}
+		}
+	}
+	{
+		//Jobs which submit jobs, with stealing on so that the sub-jobs stay local.
+		powercores::ThreadPool tp{workers};
+		tp.setWorkStealing(true);
+		tp.start();
+		std::atomic<int> done{0};
+		for(int i = 0; i < 100; i++) {
+			tp.submitJob([&] () {
+				for(int j = 0; j < 100; j++) tp.submitJob([&] () {done.fetch_add(1, std::memory_order_relaxed);});
+			});
+		}
+		while(done.load() != 100*100) std::this_thread::yield();
+		tp.stop();
+	}
+	printf("Multi-producer test passed.\n");
+	return 0;
+}
@@ -0,0 +1,70 @@
+/**This file is part of powercores, released under the terms of the Unlicense.
+See LICENSE in the root of the powercores repository for details.*/
+
+#include <powercores/thread_pool.hpp>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <stdexcept>
+#include <stdio.h>
+
+int main() {
+	printf("Testing parallelFor, parallelReduce and map...\n");
+	powercores::ThreadPool tp{4};
+	for(int stealing = 0; stealing < 2; stealing++) {
+		tp.setWorkStealing(stealing == 1);
+		tp.start();
+		//Uneven costs, so that pieces have to split.
+		int count = 10000;
+		std::vector<int> hits(count, 0);
+		auto f = tp.parallelFor(0, count, [&] (int i) {
+			if(i < 100) std::this_thread::sleep_for(std::chrono::microseconds(200));
+			hits[i]++;
+		}, 16);
+		f.get();
+		for(int i = 0; i < count; i++) {
+			if(hits[i] != 1) {
+				printf("parallelFor failed: index %i ran %i times.\n", i, hits[i]);
+				return 1;
+			}
+		}
+		auto sum = tp.parallelReduce(1, count+1, 0ll, [] (int i) {return (long long)i;}, [] (long long a, long long b) {return a+b;}, 64);
+		if(sum.get() != (long long)count*(count+1)/2) {
+			printf("parallelReduce failed.\n");
+			return 1;
+		}
+		//Empty ranges complete immediately.
+		tp.parallelFor(5, 5, [] (int) {}).get();
+		if(tp.parallelReduce(0, 0, 3, [] (int i) {return i;}, [] (int a, int b) {return a+b;}).get() != 3) {
+			printf("Empty parallelReduce failed.\n");
+			return 1;
+		}
+		//Exceptions reach the future.
+		auto failing = tp.parallelFor(0, 1000, [] (int i) {
+			if(i == 500) throw std::runtime_error("expected");
+		});
+		bool threw = false;
+		try {
+			failing.get();
+		}
+		catch(std::runtime_error &e) {
+			threw = true;
+		}
+		if(threw == false) {
+			printf("parallelFor did not propagate an exception.\n");
+			return 1;
+		}
+		//map can now be waited on.
+		std::vector<int> values(1000, 1);
+		std::atomic<int> accum{0};
+		tp.map([&] (int v, int multiplier) {accum.fetch_add(v*multiplier);}, values.begin(), values.end(), 2).get();
+		if(accum.load() != 2000) {
+			printf("map failed.\n");
+			return 1;
+		}
+		tp.stop();
+	}
+	printf("Parallel algorithms test passed.\n");
+	return 0;
+}
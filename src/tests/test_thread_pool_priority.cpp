@@ -0,0 +1,69 @@
+/**This file is part of powercores, released under the terms of the Unlicense.
+See LICENSE in the root of the powercores repository for details.*/
+
+#include <powercores/thread_pool.hpp>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <mutex>
+#include <stdio.h>
+
+//Occupy the only worker until released, so that everything submitted meanwhile queues up.
+void block(powercores::ThreadPool &tp, std::atomic<int> &go) {
+	std::atomic<int> started{0};
+	go.store(0);
+	tp.submitJob([&] () {
+		started.store(1);
+		while(go.load() == 0) std::this_thread::yield();
+	});
+	while(started.load() == 0) std::this_thread::yield();
+}
+
+int main() {
+	printf("Testing job priorities...\n");
+	for(int config = 0; config < 4; config++) {
+		powercores::ThreadPool tp{1};
+		tp.setWorkStealing(config&1);
+		tp.setJobQueueBackend(config&2 ? powercores::JobQueueBackend::LOCK_FREE : powercores::JobQueueBackend::LOCKING);
+		//Strict priority order first.
+		tp.setStarvationLimit(1000);
+		tp.start();
+		std::atomic<int> go{0};
+		std::mutex order_lock;
+		std::vector<powercores::JobPriority> order;
+		auto record = [&] (powercores::JobPriority p) {
+			return [&, p] () {
+				std::lock_guard<std::mutex> l(order_lock);
+				order.push_back(p);
+			};
+		};
+		block(tp, go);
+		for(int i = 0; i < 10; i++) tp.submitJob(powercores::JobPriority::LOW, record(powercores::JobPriority::LOW));
+		for(int i = 0; i < 10; i++) tp.submitJob(record(powercores::JobPriority::NORMAL));
+		for(int i = 0; i < 10; i++) tp.submitJob(powercores::JobPriority::HIGH, record(powercores::JobPriority::HIGH));
+		go.store(1);
+		tp.submitJobWithResult(powercores::JobPriority::LOW, [] () {}).get();
+		for(int i = 1; i < (int)order.size(); i++) {
+			if(order[i] < order[i-1]) {
+				printf("Priority test failed: a job ran before one of higher priority.\n");
+				return 1;
+			}
+		}
+		//With a limit of 2, one low priority job can't wait behind 50 high priority ones.
+		tp.setStarvationLimit(2);
+		order.clear();
+		block(tp, go);
+		tp.submitJob(powercores::JobPriority::LOW, record(powercores::JobPriority::LOW));
+		for(int i = 0; i < 50; i++) tp.submitJob(powercores::JobPriority::HIGH, record(powercores::JobPriority::HIGH));
+		go.store(1);
+		//Waiting on another low priority job wouldn't do, since it too would get a turn early.
+		tp.submitJobWithResult(powercores::JobPriority::HIGH, [] () {}).get();
+		if(order.size() != 51 || order.back() == powercores::JobPriority::LOW) {
+			printf("Priority test failed: the low priority job was starved.\n");
+			return 1;
+		}
+		tp.stop();
+	}
+	printf("Priority test passed.\n");
+	return 0;
+}
@@ -0,0 +1,96 @@
+/**This file is part of powercores, released under the terms of the Unlicense.
+See LICENSE in the root of the powercores repository for details.*/
+
+#include <powercores/thread_pool.hpp>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+
+int main() {
+	printf("Testing live resizing...\n");
+	int sizes[] = {6, 1, 4, 3, 8, 2};
+	for(int config = 0; config < 4; config++) {
+		powercores::ThreadPool tp{2};
+		tp.setWorkStealing(config&1);
+		tp.setJobQueueBackend(config&2 ? powercores::JobQueueBackend::LOCK_FREE : powercores::JobQueueBackend::LOCKING);
+		tp.start();
+		std::atomic<int> total{0};
+		int submitted = 0;
+		for(int round = 0; round < 60; round++) {
+			//Resize with work in flight, then check that a barrier still holds.
+			std::atomic<int> accum{0};
+			for(int i = 0; i < 40; i++) {
+				tp.submitJob([&, i] () {
+					if(i%8 == 0) std::this_thread::sleep_for(std::chrono::microseconds(200));
+					accum.fetch_add(1);
+					total.fetch_add(1);
+				});
+			}
+			submitted += 40;
+			tp.setThreadCount(sizes[round%6]);
+			if(tp.getThreadCount() != sizes[round%6]) {
+				printf("Resize test failed: asked for %i workers, got %i.\n", sizes[round%6], tp.getThreadCount());
+				return 1;
+			}
+			tp.submitBarrier();
+			if(tp.submitJobWithResult([&] () {return accum.load();}).get() != 40) {
+				printf("Resize test failed: a job crossed a barrier after resizing.\n");
+				return 1;
+			}
+		}
+		tp.stop();
+		if(total.load() != submitted) {
+			printf("Resize test failed: %i of %i jobs ran.\n", total.load(), submitted);
+			return 1;
+		}
+		//It restarts with the last size.
+		tp.start();
+		if(tp.getThreadCount() != sizes[59%6] || tp.submitJobWithResult([] () {return 5;}).get() != 5) {
+			printf("Resize test failed: the pool didn't restart properly.\n");
+			return 1;
+		}
+		tp.stop();
+	}
+	//A pool always has at least one worker, whether running or not.
+	{
+		powercores::ThreadPool tp{2};
+		tp.start();
+		tp.setThreadCount(0);
+		if(tp.getThreadCount() != 1 || tp.submitJobWithResult([] () {return 5;}).get() != 5) {
+			printf("Resize test failed: shrinking a running pool to 0 workers wasn't clamped to 1.\n");
+			return 1;
+		}
+		tp.stop();
+		tp.setThreadCount(-3);
+		tp.start();
+		if(tp.getThreadCount() != 1 || tp.submitJobWithResult([] () {return 5;}).get() != 5) {
+			printf("Resize test failed: a stopped pool set to -3 workers didn't start with 1.\n");
+			return 1;
+		}
+		tp.stop();
+	}
+	powercores::ThreadPool tp{1};
+	tp.setAutoScaling(1, 4, std::chrono::milliseconds(50));
+	tp.start();
+	int grewTo = 1;
+	for(int i = 0; i < 200; i++) tp.submitJob([] () {std::this_thread::sleep_for(std::chrono::milliseconds(2));});
+	for(int i = 0; i < 300 && grewTo == 1; i++) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		grewTo = std::max(grewTo, tp.getThreadCount());
+	}
+	if(grewTo == 1) {
+		printf("Resize test failed: the pool didn't grow under load.\n");
+		return 1;
+	}
+	tp.submitBarrier();
+	tp.submitJobWithResult([] () {}).get();
+	for(int i = 0; i < 400 && tp.getThreadCount() != 1; i++) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	if(tp.getThreadCount() != 1) {
+		printf("Resize test failed: the pool didn't shrink when idle, and still has %i workers.\n", tp.getThreadCount());
+		return 1;
+	}
+	tp.stop();
+	printf("Resize test passed.\n");
+	return 0;
+}
@@ -0,0 +1,67 @@
+/**This file is part of powercores, released under the terms of the Unlicense.
+See LICENSE in the root of the powercores repository for details.*/
+
+#include <powercores/thread_pool.hpp>
+#include <thread>
+#include <atomic>
+#include <stdio.h>
+
+unsigned long long histogramTotal(powercores::ThreadPoolStats &stats) {
+	unsigned long long ret = 0;
+	for(auto i: stats.latency_histogram) ret += i;
+	return ret;
+}
+
+int main() {
+	printf("Testing thread pool statistics...\n");
+	for(int stealing = 0; stealing < 2; stealing++) {
+		powercores::ThreadPool tp{2};
+		tp.setWorkStealing(stealing == 1);
+		tp.start();
+		int jobs = 1000;
+		std::atomic<int> ran{0};
+		for(int i = 0; i < jobs; i++) tp.submitJob([&] () {ran.fetch_add(1);});
+		while(ran.load() < jobs) std::this_thread::yield();
+		//Poison jobs throw, and aren't counted.
+		tp.stop();
+		auto stats = tp.getStats();
+		if(stats.workers.size() != 2 || stats.getJobsExecuted() != (unsigned long long)jobs) {
+			printf("Statistics test failed: expected %i jobs, got %llu.\n", jobs, stats.getJobsExecuted());
+			return 1;
+		}
+		if(histogramTotal(stats) < (unsigned long long)jobs || stats.latencyPercentile(0.5) == 0) {
+			printf("Statistics test failed: latencies weren't recorded.\n");
+			return 1;
+		}
+	}
+	//One worker, stuck on a job, so that everything else piles up behind it.
+	powercores::ThreadPool tp{1};
+	tp.start();
+	std::atomic<int> go{0};
+	tp.submitJob([&] () {while(go.load() == 0) std::this_thread::yield();});
+	for(int i = 0; i < 100; i++) tp.submitJob([] () {});
+	auto stats = tp.getStats();
+	if(stats.workers[0].max_queue_depth < 90 || stats.workers[0].queue_depth < 90) {
+		printf("Statistics test failed: queue depth was %u, with a maximum of %u.\n", stats.workers[0].queue_depth, stats.workers[0].max_queue_depth);
+		return 1;
+	}
+	go.store(1);
+	tp.stop();
+	tp.resetStats();
+	stats = tp.getStats();
+	if(stats.getJobsExecuted() != 0 || histogramTotal(stats) != 0 || stats.workers[0].max_queue_depth != 0) {
+		printf("Statistics test failed: resetStats didn't.\n");
+		return 1;
+	}
+	tp.setStatsEnabled(false);
+	tp.start();
+	tp.submitJobWithResult([] () {}).get();
+	tp.stop();
+	stats = tp.getStats();
+	if(stats.getJobsExecuted() != 1 || histogramTotal(stats) != 0) {
+		printf("Statistics test failed: latencies were recorded while statistics were disabled.\n");
+		return 1;
+	}
+	printf("Statistics test passed.\n");
+	return 0;
+}
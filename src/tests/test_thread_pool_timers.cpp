@@ -0,0 +1,74 @@
+/**This file is part of powercores, released under the terms of the Unlicense.
+See LICENSE in the root of the powercores repository for details.*/
+
+#include <powercores/thread_pool.hpp>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <random>
+#include <stdio.h>
+
+typedef std::chrono::steady_clock Clock;
+
+int main() {
+	printf("Testing timers...\n");
+	powercores::ThreadPool tp{2};
+	tp.start();
+	//Thousands of timers, far enough out that some go through the second level of the wheel.
+	int count = 3000;
+	std::atomic<int> fired{0}, early{0};
+	std::mt19937 gen(1);
+	std::uniform_int_distribution<int> delays(0, 400);
+	auto start = Clock::now();
+	std::vector<powercores::TimerHandle> handles;
+	for(int i = 0; i < count; i++) {
+		auto due = start+std::chrono::milliseconds(delays(gen));
+		handles.push_back(tp.submitJobAt(due, [&, due] () {
+			if(Clock::now() < due) early.fetch_add(1);
+			fired.fetch_add(1);
+		}));
+	}
+	//Cancel every other one.
+	int cancelled = 0;
+	for(int i = 0; i < count; i += 2) cancelled += handles[i].cancel();
+	std::this_thread::sleep_for(std::chrono::milliseconds(600));
+	if(fired.load() != count-cancelled || early.load() != 0) {
+		printf("Timer test failed: %i of %i timers fired, %i early, %i cancelled.\n", fired.load(), count, early.load(), cancelled);
+		return 1;
+	}
+	for(int i = 1; i < count; i += 2) {
+		if(handles[i].cancel() || handles[i].isPending()) {
+			printf("Timer test failed: a timer which fired could still be cancelled.\n");
+			return 1;
+		}
+	}
+	//Periodic jobs run until cancelled.
+	std::atomic<int> ticks{0};
+	auto periodic = tp.submitPeriodicJob(std::chrono::milliseconds(10), [&] () {ticks.fetch_add(1);});
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+	if(periodic.cancel() == false) {
+		printf("Timer test failed: couldn't cancel a periodic job.\n");
+		return 1;
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	int got = ticks.load();
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	if(got < 5 || ticks.load() != got) {
+		printf("Timer test failed: a 10 ms periodic job ran %i times in 200 ms, then %i more after it was cancelled.\n", got, ticks.load()-got);
+		return 1;
+	}
+	//A delay of nothing, and stopping with timers pending.
+	std::atomic<bool> now{false};
+	tp.submitJobAfter(std::chrono::milliseconds(0), [&] () {now.store(true);});
+	tp.submitJobAfter(std::chrono::hours(1), [] () {});
+	auto deadline = Clock::now()+std::chrono::seconds(5);
+	while(now.load() == false && Clock::now() < deadline) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	tp.stop();
+	if(now.load() == false) {
+		printf("Timer test failed: a job with no delay didn't run.\n");
+		return 1;
+	}
+	printf("Timer test passed.\n");
+	return 0;
+}
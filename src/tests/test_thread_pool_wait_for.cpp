@@ -0,0 +1,135 @@
+/**This file is part of powercores, released under the terms of the Unlicense.
+See LICENSE in the root of the powercores repository for details.*/
+
+#include <powercores/thread_pool.hpp>
+#include <atomic>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <future>
+#include <cstdlib>
+#include <stdio.h>
+
+//Every call waits on two sub-jobs from inside a job.  With only two workers, this deadlocks unless waiting workers run the sub-jobs themselves.
+int fib(powercores::ThreadPool &tp, int n) {
+	if(n < 2) return n;
+	auto a = tp.submitJobWithFuture([&tp, n] () {return fib(tp, n-1);});
+	auto b = tp.submitJobWithResult([&tp, n] () {return fib(tp, n-2);});
+	tp.waitFor(a);
+	tp.waitFor(b);
+	return a.get()+b.get();
+}
+
+bool testNested(bool stealing, powercores::JobQueueBackend backend) {
+	powercores::ThreadPool tp{2};
+	tp.setWorkStealing(stealing);
+	tp.setJobQueueBackend(backend);
+	tp.start();
+	auto f = tp.submitJobWithFuture([&tp] () {return fib(tp, 14);});
+	tp.waitFor(f);
+	int got = f.get();
+	tp.stop();
+	if(got != 377) {
+		printf("waitFor test failed: nested fib gave %i with stealing %i.\n", got, (int)stealing);
+		return false;
+	}
+	return true;
+}
+
+//With one worker and stealing off, the worker takes several jobs from its queue at once.
+//A job waiting on one which was taken in the same batch must run it, since nobody else can.
+bool testSameBatch(powercores::JobQueueBackend backend) {
+	powercores::ThreadPool tp{1};
+	tp.setJobQueueBackend(backend);
+	tp.start();
+	std::atomic<bool> release{false};
+	tp.submitJob([&] () {while(release.load() == false) std::this_thread::yield();});
+	std::shared_future<int> inner;
+	std::atomic<bool> innerReady{false};
+	auto outer = tp.submitJobWithResult([&] () {
+		while(innerReady.load() == false) std::this_thread::yield();
+		tp.waitFor(inner);
+		return inner.get()+1;
+	});
+	inner = tp.submitJobWithResult([] () {return 41;}).share();
+	innerReady.store(true);
+	release.store(true);
+	if(outer.wait_for(std::chrono::seconds(10)) != std::future_status::ready) {
+		printf("waitFor test failed: a job waiting on a job from its worker's batch hung.\n");
+		//The pool can't be stopped, so don't try.
+		fflush(stdout);
+		std::_Exit(1);
+	}
+	int got = outer.get();
+	tp.stop();
+	if(got != 42) {
+		printf("waitFor test failed: a job waiting on its worker's batch got %i.\n", got);
+		return false;
+	}
+	return true;
+}
+
+//A thread outside the pool waits for something unrelated while the only worker is busy, and a job J sits ahead of a barrier.
+//The waiter may run J, but the barrier must still hold: the job after it has to see J finished.
+//With waiterFirst, the waiter can take J before the barrier is submitted; otherwise the barrier is already queued when it starts waiting.
+bool testBarrierOrder(powercores::JobQueueBackend backend, bool waiterFirst) {
+	powercores::ThreadPool tp{1};
+	tp.setJobQueueBackend(backend);
+	tp.start();
+	std::atomic<bool> busyStarted{false}, jDone{false};
+	tp.submitJob([&] () {
+		busyStarted.store(true);
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	});
+	while(busyStarted.load() == false) std::this_thread::yield();
+	tp.submitJob([&] () {
+		std::this_thread::sleep_for(std::chrono::milliseconds(200));
+		jDone.store(true);
+	});
+	std::promise<void> unrelated;
+	auto unrelatedFuture = unrelated.get_future();
+	std::thread waiter;
+	if(waiterFirst) {
+		waiter = std::thread([&] () {tp.waitFor(unrelatedFuture);});
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	}
+	tp.submitBarrier();
+	auto k = tp.submitJobWithResult([&] () {return jDone.load();});
+	if(waiterFirst == false) waiter = std::thread([&] () {tp.waitFor(unrelatedFuture);});
+	bool sawJ = k.get();
+	unrelated.set_value();
+	waiter.join();
+	tp.stop();
+	if(sawJ == false) {
+		printf("waitFor test failed: a job ran before a job ahead of its barrier had finished, with the waiter starting %s the barrier.\n", waiterFirst ? "before" : "after");
+		return false;
+	}
+	return true;
+}
+
+int main() {
+	printf("Testing ThreadPool::waitFor...\n");
+	for(int stealing = 0; stealing < 2; stealing++) {
+		if(testNested(stealing == 1, powercores::JobQueueBackend::LOCKING) == false) return 1;
+		if(testNested(stealing == 1, powercores::JobQueueBackend::LOCK_FREE) == false) return 1;
+	}
+	if(testSameBatch(powercores::JobQueueBackend::LOCKING) == false) return 1;
+	if(testSameBatch(powercores::JobQueueBackend::LOCK_FREE) == false) return 1;
+	for(int waiterFirst = 0; waiterFirst < 2; waiterFirst++) {
+		if(testBarrierOrder(powercores::JobQueueBackend::LOCKING, waiterFirst == 1) == false) return 1;
+		if(testBarrierOrder(powercores::JobQueueBackend::LOCK_FREE, waiterFirst == 1) == false) return 1;
+	}
+	//waitForBarrier waits for everything before the barrier, and the caller may run some of it.
+	powercores::ThreadPool tp{2};
+	tp.start();
+	std::atomic<int> done{0};
+	for(int i = 0; i < 1000; i++) tp.submitJob([&] () {done.fetch_add(1);});
+	tp.waitForBarrier();
+	if(done.load() != 1000) {
+		printf("waitFor test failed: waitForBarrier returned with %i of 1000 jobs done.\n", done.load());
+		return 1;
+	}
+	tp.stop();
+	printf("waitFor test passed.\n");
+	return 0;
+}
@@ -0,0 +1,80 @@
+/**This file is part of powercores, released under the terms of the Unlicense.
+See LICENSE in the root of the powercores repository for details.*/
+
+#include <powercores/thread_pool.hpp>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <stdio.h>
+
+int main() {
+	printf("Testing work stealing...\n");
+	powercores::ThreadPool tp{2};
+	tp.setWorkStealing(true);
+	tp.start();
+	//One slow job, then quick jobs round-robined over both queues.
+	//Half of the quick jobs land behind the slow one, and must be stolen to finish before it does.
+	std::atomic<int> quick{0};
+	std::atomic<int> quickBeforeSlow{-1};
+	tp.submitJob([&] () {
+		std::this_thread::sleep_for(std::chrono::milliseconds(500));
+		quickBeforeSlow.store(quick.load());
+	});
+	int quickJobs = 100;
+	for(int i = 0; i < quickJobs; i++) tp.submitJob([&] () {quick.fetch_add(1);});
+	tp.submitBarrier();
+	auto f = tp.submitJobWithResult([] () {});
+	f.wait();
+	if(quickBeforeSlow.load() != quickJobs) {
+		printf("Work stealing test failed: only %i of %i quick jobs ran before the slow one finished.\n", quickBeforeSlow.load(), quickJobs);
+		return 1;
+	}
+	//Barriers must still hold with uneven jobs.
+	int iterations = 200;
+	int jobsPerIteration = 50;
+	std::atomic<int> accum{0};
+	tp.setThreadCount(8);
+	for(int iteration = 0; iteration < iterations; iteration++) {
+		accum.store(0);
+		for(int i = 0; i < jobsPerIteration; i++) {
+			tp.submitJob([&, i] () {
+				if(i%10 == 0) std::this_thread::sleep_for(std::chrono::microseconds(500));
+				accum.fetch_add(1);
+			});
+		}
+		tp.submitBarrier();
+		auto f = tp.submitJobWithResult([&] () {return accum.load();});
+		if(f.get() != jobsPerIteration) {
+			printf("Work stealing test failed: a job crossed a barrier.\n");
+			return 1;
+		}
+	}
+	tp.stop();
+	//A worker whose only company is a job it can't steal must park, not spin.
+	//Worker 0 is busy, and the job submitted to all threads waits behind it; worker 1 runs its copy and should then sleep.
+	powercores::ThreadPool tp2{2};
+	tp2.setWorkStealing(true);
+	tp2.start();
+	tp2.submitJobToAllThreads([] () {});
+	tp2.submitBarrier();
+	tp2.submitJobWithResult([] () {}).wait();
+	std::atomic<bool> busyStarted{false};
+	//Pinned, so that worker 1 can't steal it before worker 0 starts it.
+	tp2.submitJobToAllThreads([&] () {
+		if(busyStarted.exchange(true)) return;
+		std::this_thread::sleep_for(std::chrono::milliseconds(500));
+	});
+	tp2.submitJobToAllThreads([] () {});
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	auto cpuBefore = std::clock();
+	std::this_thread::sleep_for(std::chrono::milliseconds(300));
+	double cpuSeconds = (double)(std::clock()-cpuBefore)/CLOCKS_PER_SEC;
+	tp2.stop();
+	if(cpuSeconds > 0.1) {
+		printf("Work stealing test failed: an idle worker used %f CPU seconds spinning on a job it couldn't steal.\n", cpuSeconds);
+		return 1;
+	}
+	printf("Work stealing test passed.\n");
+	return 0;
+}